@@ -5,36 +5,127 @@
 
 using namespace std::chrono_literals;
 
+namespace {
+    /**
+     * Most threads of the sorting, more of them are a mistake in the config.
+     */
+    constexpr uint64_t kMaxThreads = 1024;
+    /**
+     * The polyphase merge needs at least two input tapes and the output one.
+     */
+    constexpr uint64_t kMinPolyphaseTapes = 3;
+    /**
+     * Most temporary tapes of the polyphase merge, every one of them is an open file.
+     */
+    constexpr uint64_t kMaxPolyphaseTapes = 1024;
+
+    /**
+     * Read an optional count of the config.
+     * Throws std::invalid_argument if it is out of [min, max].
+     *
+     * @param config config of the sorting
+     * @param field name of the field
+     * @param default_value value if the field is not set
+     * @param min least allowed value
+     * @param max greatest allowed value
+     * @return count
+     */
+    uint64_t ReadCount(config_reader::SimpleYamlReader &config,
+                       const std::string &field,
+                       uint64_t default_value,
+                       uint64_t min,
+                       uint64_t max) {
+        if (config[field].AsString().empty()) {
+            return default_value;
+        }
+        uint64_t count = config[field].AsUInt64();
+        if (count < min || count > max) {
+            throw std::invalid_argument(field + " should be from " + std::to_string(min) + " to " +
+                                        std::to_string(max) + ", got " + std::to_string(count));
+        }
+        return count;
+    }
+} // namespace
+
 int main(int argc, char *argv[]) {
     std::filesystem::path path = argv[1];
 
     config_reader::SimpleYamlReader config(path);
     config.ReadConfig();
 
-    size_t size = config["N"].AsInt32();
-    size_t memory = config["M"].AsInt32();
+    tape_structure::TapeSize size = config["N"].AsUInt64();
+    tape_structure::MemorySize memory = config["M"].AsUInt64();
 
     std::chrono::milliseconds delay_for_read = config["delay_for_read"].AsMilliseconds();
     std::chrono::milliseconds delay_for_put = config["delay_for_put"].AsMilliseconds();
     std::chrono::milliseconds delay_for_shift = config["delay_for_shift"].AsMilliseconds();
+    tape_structure::DelayMode delay_mode = tape_structure::ParseDelayMode(config["delay_mode"].AsString());
+    std::chrono::milliseconds sleep_batch{};
+    if (!config["delay_sleep_batch"].AsString().empty()) {
+        sleep_batch = config["delay_sleep_batch"].AsMilliseconds();
+    }
+    tape_structure::Delays delays(delay_for_read, delay_for_put, delay_for_shift, delay_mode, sleep_batch);
 
     std::filesystem::path path_in = config["path_in"].AsPath();
     std::filesystem::path path_out = config["path_out"].AsPath();
 
+    tape_structure::TapeFormat format_in = tape_structure::ParseTapeFormat(config["format_in"].AsString());
+    tape_structure::TapeFormat format_out = tape_structure::ParseTapeFormat(config["format_out"].AsString());
+    tape_structure::TapeStorage storage = tape_structure::ParseTapeStorage(config["storage"].AsString());
+    auto storage_for = [storage](tape_structure::TapeFormat format) {
+        return format == tape_structure::TapeFormat::kBinary && storage == tape_structure::TapeStorage::kMmap
+                       ? storage
+                       : tape_structure::TapeStorage::kStream;
+    };
+
     tape_structure::Tape tape_in(
             path_in,
             size,
             tape_structure::Tape::CountChunkSize(memory, size),
-            delay_for_read,
-            delay_for_put,
-            delay_for_shift);
+            delays,
+            format_in,
+            storage_for(format_in));
     tape_structure::Tape tape_out(path_out,
-                                  delay_for_read,
-                                  delay_for_put,
-                                  delay_for_shift);
-    tape_structure::TapeSorter sorter(tape_in, tape_out);
+                                  delays,
+                                  format_out,
+                                  storage_for(format_out));
+    tape_structure::SortOptions options;
+    options.read_ahead_ = config["read_ahead"].AsString() == "true";
+    options.split_strategy_ = tape_structure::ParseSplitStrategy(config["split"].AsString());
+    options.workers_ = ReadCount(config, "workers", options.workers_, 1, kMaxThreads);
+    options.merge_io_limit_ = ReadCount(config, "merge_io_limit", options.merge_io_limit_, 0, kMaxThreads);
+    options.alternate_directions_ = config["alternate_directions"].AsString() == "true";
+    options.huge_pages_ = config["huge_pages"].AsString() == "true";
+    if (!config["tmp_dir"].AsString().empty()) {
+        options.tmp_dir_ = config["tmp_dir"].AsPath();
+    }
+    options.polyphase_tapes_ = ReadCount(config, "polyphase_tapes", 0, 0, kMaxPolyphaseTapes);
+    if (options.polyphase_tapes_ != 0 && options.polyphase_tapes_ < kMinPolyphaseTapes) {
+        throw std::invalid_argument("polyphase_tapes should be 0 or at least " + std::to_string(kMinPolyphaseTapes));
+    }
+    if (!config["tmp_format"].AsString().empty()) {
+        options.tmp_format_ = tape_structure::ParseTapeFormat(config["tmp_format"].AsString());
+    }
+    // Only binary tapes can be mapped, the temporary tapes of other formats are streamed then.
+    tape_structure::TapeStorage tmp_storage =
+            options.tmp_format_ != tape_structure::TapeFormat::kBinary && storage == tape_structure::TapeStorage::kMmap
+                    ? tape_structure::TapeStorage::kStream
+                    : storage;
+    options.tmp_storage_ =
+            tape_structure::TapeSorter::ChooseTmpStorage(memory, size, tmp_storage, options.polyphase_tapes_);
+    options.memory_ = memory;
+    uint64_t tmp_memory = tape_structure::MemoryPlan::CountTmpTapesMemory(size, options.polyphase_tapes_);
+    if (options.tmp_storage_ == tape_structure::TapeStorage::kMemory && tmp_memory < memory) {
+        options.memory_ -= tmp_memory;
+    }
+
+    tape_structure::TapeSorter sorter(tape_in, tape_out, options);
 
     sorter.Sort();
+    if (delay_mode == tape_structure::DelayMode::kVirtual) {
+        std::cout << "Simulated time: " << sorter.GetSimulatedTime().count() << " ms" << std::endl;
+        std::cout << "Shifts: " << sorter.GetShiftCount() << std::endl;
+    }
 
     return 0;
 }
\ No newline at end of file
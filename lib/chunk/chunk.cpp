@@ -1,5 +1,9 @@
 #include "chunk.hpp"
 
+#include <utility>
+
+#include "../device/tape_device.hpp"
+
 namespace tape_structure {
     Chunk::Chunk(Delays delays,
                  ChunksCount chunk_number,
@@ -8,6 +12,34 @@ namespace tape_structure {
                                    size_(size),
                                    pos_(0) {}
 
+    Chunk::Chunk(const Chunk &other) : delays_(other.delays_),
+                                       chunk_number_(other.chunk_number_),
+                                       size_(other.size_),
+                                       pos_(other.pos_),
+                                       numbers_(other.numbers_.GetPool()),
+                                       dirty_(other.dirty_) {
+        numbers_.Assign(other.GetChunkNumbers());
+    }
+
+    Chunk &Chunk::operator=(const Chunk &other) {
+        if (&other == this) {
+            return *this;
+        }
+
+        delays_ = other.delays_;
+        chunk_number_ = other.chunk_number_;
+        size_ = other.size_;
+        pos_ = other.pos_;
+        if (numbers_.GetPool() != other.numbers_.GetPool()) {
+            numbers_ = ChunkBuffer(other.numbers_.GetPool());
+        }
+        numbers_.Assign(other.GetChunkNumbers());
+        window_ = nullptr;
+        dirty_ = other.dirty_;
+
+        return *this;
+    }
+
     ChunkSize Chunk::GetPos() const {
         return pos_;
     }
@@ -17,8 +49,8 @@ namespace tape_structure {
     }
 
     NumberType Chunk::GetCurrentNumber() const {
-        std::this_thread::sleep_for(delays_.delay_for_read_);
-        return numbers_[pos_];
+        delays_.Wait(delays_.delay_for_read_);
+        return GetData()[pos_];
     }
 
     bool Chunk::IsLeftEdge() const {
@@ -41,11 +73,15 @@ namespace tape_structure {
         return pos_ == another_pos && another_chunk_number == chunk_number_;
     }
 
+    bool Chunk::IsDirty() const {
+        return dirty_;
+    }
+
     bool Chunk::MoveLeftPos() {
         if (IsRightEdge()) {
             return false;
         }
-        std::this_thread::sleep_for(delays_.delay_for_shift_);
+        delays_.Shift();
         pos_++;
 
         return true;
@@ -55,33 +91,37 @@ namespace tape_structure {
         if (!IsPossibleTakeLeftNumber() || IsLeftEdge()) {
             return false;
         }
-        std::this_thread::sleep_for(delays_.delay_for_shift_);
+        delays_.Shift();
         pos_--;
 
         return true;
     }
 
-    void Chunk::ReadNewChunk(std::fstream &from, ChunksCount new_chunk_number, ChunkSize new_size) {
+    void Chunk::ReadNewChunk(TapeDevice &from, ChunksCount new_chunk_number, ChunkSize new_size) {
         size_ = new_size;
         pos_ = new_chunk_number >= chunk_number_ ? size_ - 1 : 0;
         chunk_number_ = new_chunk_number;
-        numbers_.clear();
-        numbers_.resize(size_);
-        for (NumberType &num: numbers_) {
-            std::this_thread::sleep_for(delays_.delay_for_shift_);
-            std::this_thread::sleep_for(delays_.delay_for_read_);
-            from >> num;
+        dirty_ = false;
+        window_ = from.MapChunk(chunk_number_);
+        delays_.Shift(size_);
+        delays_.Wait(delays_.delay_for_read_, size_);
+        if (window_ == nullptr) {
+            // The buffer is only grown, the numbers are overwritten by the device.
+            numbers_.Resize(size_);
+            from.ReadChunk(chunk_number_, numbers_.GetNumbers());
         }
     }
 
     void Chunk::PutNumberInArrayByPos(const NumberType &number, const ChunkSize pos) {
-        std::this_thread::sleep_for(delays_.delay_for_put_);
-        numbers_[pos] = number;
+        delays_.Wait(delays_.delay_for_put_);
+        GetData()[pos] = number;
+        dirty_ = window_ == nullptr;
     }
 
-    void Chunk::PrintChunk(std::fstream &to) {
-        for (NumberType num: numbers_) {
-            to << num << ' ';
+    void Chunk::PrintChunk(TapeDevice &to) {
+        dirty_ = false;
+        if (window_ == nullptr) {
+            to.WriteChunk(chunk_number_, numbers_.GetNumbers());
         }
     }
 
@@ -89,11 +129,25 @@ namespace tape_structure {
         chunk_number_ = 0;
         size_ = 0;
         pos_ = 0;
-        numbers_.clear();
+        dirty_ = false;
+        window_ = nullptr;
+        numbers_.Release();
+    }
+
+    void Chunk::SetPool(std::shared_ptr<ChunkPool> pool) {
+        numbers_ = ChunkBuffer(std::move(pool));
+    }
+
+    std::span<const NumberType> Chunk::GetChunkNumbers() const {
+        return {GetData(), window_ != nullptr ? size_ : numbers_.GetSize()};
+    }
+
+    NumberType *Chunk::GetData() {
+        return window_ != nullptr ? window_ : numbers_.GetData();
     }
 
-    std::vector<NumberType> Chunk::GetChunkNumbers() const {
-        return numbers_;
+    const NumberType *Chunk::GetData() const {
+        return window_ != nullptr ? window_ : numbers_.GetData();
     }
 
     void Chunk::MoveToLeftEdge() {
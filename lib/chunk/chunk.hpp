@@ -1,23 +1,24 @@
 #pragma once
 
-#include <cstdint>
-#include <fstream>
-#include <vector>
+#include <memory>
+#include <span>
 
 #include "../delays/delays.hpp"
+#include "chunk_pool.hpp"
 
 namespace tape_structure {
-    using NumberType = int32_t;
-    using ChunkSize = uint32_t;
-    using ChunksCount = uint32_t;
+    class TapeDevice;
 
     class Chunk {
     public:
         Chunk() = default;
         Chunk(Delays delays, ChunksCount chunk_number, ChunkSize size);
 
-        Chunk(const Chunk &) = default;
-        Chunk &operator=(const Chunk &) = default;
+        /**
+         * The copy always owns its numbers, even if the original chunk is a window.
+         */
+        Chunk(const Chunk &);
+        Chunk &operator=(const Chunk &);
 
         Chunk(Chunk &&) noexcept = default;
         Chunk &operator=(Chunk &&) noexcept = default;
@@ -44,9 +45,9 @@ namespace tape_structure {
         /**
          * Get all numbers in the chunk.
          *
-         * @return vector of numbers.
+         * @return view of the numbers, valid until a new chunk is read.
          */
-        [[nodiscard]] std::vector<NumberType> GetChunkNumbers() const;
+        [[nodiscard]] std::span<const NumberType> GetChunkNumbers() const;
 
         /**
          * Checking for the number to the left of the magnetic head.
@@ -73,6 +74,12 @@ namespace tape_structure {
          * @return true if the position and the chunk number are the same else false.
          */
         [[nodiscard]] bool IsMatchWith(ChunkSize another_pos, ChunksCount another_chunk_number) const;
+        /**
+         * Checking that the chunk has been changed since it was read or printed.
+         *
+         * @return true if the chunk has been changed else false.
+         */
+        [[nodiscard]] bool IsDirty() const;
 
         /**
          * Move the chunk to the right by one position.
@@ -101,13 +108,15 @@ namespace tape_structure {
         void MoveToRightEdge();
 
         /**
-         * Read new chunk from a file.
+         * Read new chunk from a device.
+         * If the device can map the chunk, the chunk becomes a window into the device memory:
+         * the numbers are not copied and putting a number changes them in place.
          *
-         * @param from file stream from where the new chunk will be read.
+         * @param from device from where the new chunk will be read.
          * @param new_chunk_number number of the new chunk.
          * @param new_size size of the new chunk.
          */
-        void ReadNewChunk(std::fstream &from, ChunksCount new_chunk_number, ChunkSize new_size);
+        void ReadNewChunk(TapeDevice &from, ChunksCount new_chunk_number, ChunkSize new_size);
         /**
          * Put a new number in the chunk array.
          *
@@ -116,16 +125,24 @@ namespace tape_structure {
          */
         void PutNumberInArrayByPos(const NumberType &number, ChunkSize pos);
         /**
-         * Output a chunk to a file.
+         * Output a chunk to a device.
          *
-         * @param to file stream into which the chunk will be printed.
+         * @param to device into which the chunk will be printed.
          */
-        void PrintChunk(std::fstream &to);
+        void PrintChunk(TapeDevice &to);
 
         /**
          * Clear chunk without changing delays.
+         * The buffer of the numbers is given back to its pool.
          */
         void Destroy();
+        /**
+         * Take the buffer of the numbers from a pool, so the buffers of the chunks are reused.
+         * The numbers of the chunk are dropped, it should be called before the chunk is read.
+         *
+         * @param pool pool of chunk buffers (nullptr - the buffer is allocated by the chunk)
+         */
+        void SetPool(std::shared_ptr<ChunkPool> pool);
 
     private:
         /**
@@ -140,6 +157,13 @@ namespace tape_structure {
          * @return true if the current position is the rightmost else false.
          */
         [[nodiscard]] bool IsRightEdge() const;
+        /**
+         * Get the numbers of the chunk, whether they are owned or a window.
+         *
+         * @return pointer to the first number.
+         */
+        [[nodiscard]] NumberType *GetData();
+        [[nodiscard]] const NumberType *GetData() const;
 
         Delays delays_;
 
@@ -156,8 +180,16 @@ namespace tape_structure {
          */
         ChunkSize pos_{};
         /**
-         * Array of chunk numbers.
+         * Buffer of chunk numbers.
+         */
+        ChunkBuffer numbers_;
+        /**
+         * Numbers of the chunk if it is a window, otherwise nullptr.
+         */
+        NumberType *window_ = nullptr;
+        /**
+         * The chunk has been changed since it was read or printed.
          */
-        std::vector<NumberType> numbers_;
+        bool dirty_ = false;
     };
 } // namespace tape_structure
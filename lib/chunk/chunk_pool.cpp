@@ -0,0 +1,233 @@
+#include "chunk_pool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace tape_structure {
+    ChunkBuffer::ChunkBuffer(std::shared_ptr<ChunkPool> pool) : pool_(std::move(pool)) {}
+
+    ChunkBuffer::ChunkBuffer(ChunkBuffer &&other) noexcept : pool_(std::move(other.pool_)),
+                                                            data_(std::exchange(other.data_, nullptr)),
+                                                            size_(std::exchange(other.size_, 0)),
+                                                            capacity_(std::exchange(other.capacity_, 0)) {}
+
+    ChunkBuffer &ChunkBuffer::operator=(ChunkBuffer &&other) noexcept {
+        if (&other == this) {
+            return *this;
+        }
+
+        Release();
+        pool_ = std::move(other.pool_);
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        capacity_ = std::exchange(other.capacity_, 0);
+
+        return *this;
+    }
+
+    ChunkBuffer::~ChunkBuffer() {
+        Release();
+    }
+
+    size_t ChunkBuffer::GetSize() const {
+        return size_;
+    }
+
+    bool ChunkBuffer::IsEmpty() const {
+        return size_ == 0;
+    }
+
+    size_t ChunkBuffer::GetCapacity() const {
+        return capacity_;
+    }
+
+    const std::shared_ptr<ChunkPool> &ChunkBuffer::GetPool() const {
+        return pool_;
+    }
+
+    NumberType *ChunkBuffer::GetData() {
+        return data_;
+    }
+
+    const NumberType *ChunkBuffer::GetData() const {
+        return data_;
+    }
+
+    std::span<NumberType> ChunkBuffer::GetNumbers() {
+        return {data_, size_};
+    }
+
+    std::span<const NumberType> ChunkBuffer::GetNumbers() const {
+        return {data_, size_};
+    }
+
+    void ChunkBuffer::Reserve(size_t capacity) {
+        if (capacity <= capacity_) {
+            return;
+        }
+
+        ChunkPool::Block block = pool_ ? pool_->Take(capacity) : ChunkPool::Allocate(capacity, false);
+        std::copy(data_, data_ + size_, block.data_);
+        size_t size = size_;
+        Release();
+        data_ = block.data_;
+        size_ = size;
+        capacity_ = block.capacity_;
+    }
+
+    void ChunkBuffer::Resize(size_t size) {
+        Reserve(size);
+        size_ = size;
+    }
+
+    void ChunkBuffer::Append(std::span<const NumberType> numbers) {
+        if (size_ + numbers.size() > capacity_) {
+            Reserve(std::max(size_ + numbers.size(), 2 * capacity_));
+        }
+        std::copy(numbers.begin(), numbers.end(), data_ + size_);
+        size_ += numbers.size();
+    }
+
+    void ChunkBuffer::Assign(std::span<const NumberType> numbers) {
+        size_ = 0;
+        Append(numbers);
+    }
+
+    void ChunkBuffer::Clear() {
+        size_ = 0;
+    }
+
+    void ChunkBuffer::Release() {
+        if (data_ != nullptr) {
+            if (pool_) {
+                pool_->Give({data_, capacity_});
+            } else {
+                ChunkPool::Free({data_, capacity_});
+            }
+        }
+        data_ = nullptr;
+        size_ = 0;
+        capacity_ = 0;
+    }
+
+    ChunkPool::ChunkPool(bool huge_pages) : huge_pages_(huge_pages) {}
+
+    ChunkPool::~ChunkPool() {
+        Trim();
+    }
+
+    size_t ChunkPool::CountFreeBuffers() const {
+        std::lock_guard lock(mutex_);
+        return free_.size();
+    }
+
+    size_t ChunkPool::CountMemory() const {
+        std::lock_guard lock(mutex_);
+        return memory_;
+    }
+
+    void ChunkPool::Trim() {
+        std::vector<Block> blocks;
+        {
+            std::lock_guard lock(mutex_);
+            blocks.swap(free_);
+            for (Block block: blocks) {
+                memory_ -= block.capacity_ * sizeof(NumberType);
+            }
+        }
+        for (Block block: blocks) {
+            Free(block);
+        }
+    }
+
+    void ChunkPool::SetLimit(size_t limit) {
+        std::lock_guard lock(mutex_);
+        limit_ = limit;
+    }
+
+    size_t ChunkPool::CountBlockMemory(size_t capacity, bool huge_pages) {
+        size_t bytes = std::max<size_t>(capacity, 1) * sizeof(NumberType);
+        size_t alignment = huge_pages && bytes >= kHugePageSize ? kHugePageSize : kAlignment;
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+    size_t ChunkPool::CountAllocations() const {
+        std::lock_guard lock(mutex_);
+        return allocations_;
+    }
+
+    ChunkPool::Block ChunkPool::Take(size_t capacity) {
+        std::vector<Block> replaced;
+        {
+            std::lock_guard lock(mutex_);
+            auto best = free_.end();
+            for (auto it = free_.begin(); it != free_.end(); ++it) {
+                if (it->capacity_ >= capacity && (best == free_.end() || it->capacity_ < best->capacity_)) {
+                    best = it;
+                }
+            }
+            if (best != free_.end()) {
+                Block block = *best;
+                *best = free_.back();
+                free_.pop_back();
+                return block;
+            }
+
+            size_t memory = CountBlockMemory(capacity, huge_pages_);
+            auto by_capacity = [](const Block &lhs, const Block &rhs) {
+                return lhs.capacity_ < rhs.capacity_;
+            };
+            while (!free_.empty() && (replaced.empty() || (limit_ != 0 && memory_ + memory > limit_))) {
+                auto biggest = std::max_element(free_.begin(), free_.end(), by_capacity);
+                replaced.push_back(*biggest);
+                memory_ -= biggest->capacity_ * sizeof(NumberType);
+                *biggest = free_.back();
+                free_.pop_back();
+            }
+            allocations_++;
+            memory_ += memory;
+        }
+        for (Block block: replaced) {
+            Free(block);
+        }
+        return Allocate(capacity, huge_pages_);
+    }
+
+    void ChunkPool::Give(Block block) {
+        {
+            std::lock_guard lock(mutex_);
+            if (limit_ == 0 || memory_ <= limit_) {
+                free_.push_back(block);
+                return;
+            }
+            memory_ -= block.capacity_ * sizeof(NumberType);
+        }
+        Free(block);
+    }
+
+    ChunkPool::Block ChunkPool::Allocate(size_t capacity, bool huge_pages) {
+        size_t bytes = CountBlockMemory(capacity, huge_pages);
+        size_t alignment = huge_pages && bytes >= kHugePageSize ? kHugePageSize : kAlignment;
+
+        void *data = std::aligned_alloc(alignment, bytes);
+        if (data == nullptr) {
+            throw std::bad_alloc();
+        }
+#ifdef __linux__
+        if (alignment == kHugePageSize) {
+            ::madvise(data, bytes, MADV_HUGEPAGE);
+        }
+#endif
+        return {static_cast<NumberType *>(data), bytes / sizeof(NumberType)};
+    }
+
+    void ChunkPool::Free(Block block) {
+        std::free(block.data_);
+    }
+} // namespace tape_structure
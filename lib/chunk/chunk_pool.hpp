@@ -0,0 +1,273 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "number_type.hpp"
+
+namespace tape_structure {
+    class ChunkPool;
+
+    /**
+     * Buffer of the numbers of a chunk.
+     * The memory is taken from the pool and is given back to it when the buffer is released or destroyed,
+     * so the next chunk buffer reuses it instead of allocating and faulting in new pages.
+     * A buffer without a pool allocates and frees its memory itself.
+     * The numbers are not initialized when the buffer grows.
+     */
+    class ChunkBuffer {
+    public:
+        ChunkBuffer() = default;
+        explicit ChunkBuffer(std::shared_ptr<ChunkPool> pool);
+
+        ChunkBuffer(const ChunkBuffer &) = delete;
+        ChunkBuffer &operator=(const ChunkBuffer &) = delete;
+
+        ChunkBuffer(ChunkBuffer &&other) noexcept;
+        ChunkBuffer &operator=(ChunkBuffer &&other) noexcept;
+
+        ~ChunkBuffer();
+
+        /**
+         * Get the count of numbers in the buffer.
+         *
+         * @return size of the buffer
+         */
+        [[nodiscard]] size_t GetSize() const;
+        /**
+         * Checking that there are no numbers in the buffer.
+         *
+         * @return true if the buffer is empty else false
+         */
+        [[nodiscard]] bool IsEmpty() const;
+        /**
+         * Get the count of numbers the buffer holds without taking more memory.
+         *
+         * @return capacity of the buffer
+         */
+        [[nodiscard]] size_t GetCapacity() const;
+        /**
+         * Get the pool the memory is taken from.
+         *
+         * @return pool, nullptr if the buffer has no pool
+         */
+        [[nodiscard]] const std::shared_ptr<ChunkPool> &GetPool() const;
+
+        /**
+         * Get the first number of the buffer.
+         *
+         * @return pointer to the first number
+         */
+        [[nodiscard]] NumberType *GetData();
+        [[nodiscard]] const NumberType *GetData() const;
+        /**
+         * Get all numbers of the buffer.
+         *
+         * @return view of the numbers, valid until the buffer grows or is released
+         */
+        [[nodiscard]] std::span<NumberType> GetNumbers();
+        [[nodiscard]] std::span<const NumberType> GetNumbers() const;
+
+        /**
+         * Make sure the buffer holds at least `capacity` numbers. The numbers are kept.
+         *
+         * @param capacity count of numbers
+         */
+        void Reserve(size_t capacity);
+        /**
+         * Change the count of numbers in the buffer. The numbers are kept, the new ones are not initialized.
+         *
+         * @param size new size of the buffer
+         */
+        void Resize(size_t size);
+        /**
+         * Append numbers to the end of the buffer.
+         *
+         * @param numbers appended numbers
+         */
+        void Append(std::span<const NumberType> numbers);
+        /**
+         * Replace the numbers of the buffer with a copy of the given ones.
+         *
+         * @param numbers copied numbers
+         */
+        void Assign(std::span<const NumberType> numbers);
+        /**
+         * Remove the numbers from the buffer, the memory is kept.
+         */
+        void Clear();
+        /**
+         * Remove the numbers from the buffer and give the memory back to the pool.
+         */
+        void Release();
+
+    private:
+        /**
+         * Pool the memory is taken from, nullptr if the buffer allocates it itself.
+         */
+        std::shared_ptr<ChunkPool> pool_;
+        /**
+         * Memory of the buffer.
+         */
+        NumberType *data_ = nullptr;
+        /**
+         * Count of numbers in the buffer.
+         */
+        size_t size_ = 0;
+        /**
+         * Count of numbers the memory holds.
+         */
+        size_t capacity_ = 0;
+    };
+
+    /**
+     * Pool of the memory of chunk buffers, shared by the tapes of one sorting.
+     * The tapes of a merge level are created and destroyed all the time, but their chunks are of the same size,
+     * so the memory released by the finished merges is taken by the next ones.
+     * The memory is aligned to the cache line, and with huge pages the buffers of at least a huge page
+     * are aligned to it and are backed by transparent huge pages (on Linux), so they take fewer page faults
+     * and TLB misses.
+     * It is safe to use the pool from several threads.
+     */
+    class ChunkPool {
+    public:
+        /**
+         * Create an empty pool.
+         *
+         * @param huge_pages back the big buffers by transparent huge pages
+         */
+        explicit ChunkPool(bool huge_pages = false);
+
+        ChunkPool(const ChunkPool &) = delete;
+        ChunkPool &operator=(const ChunkPool &) = delete;
+
+        ~ChunkPool();
+
+        /**
+         * Get the count of released buffers kept for reuse.
+         *
+         * @return count of free buffers
+         */
+        [[nodiscard]] size_t CountFreeBuffers() const;
+        /**
+         * Get the count of blocks the pool has allocated, the taken buffers which were not reused.
+         *
+         * @return count of allocations
+         */
+        [[nodiscard]] size_t CountAllocations() const;
+        /**
+         * Get the memory of all the blocks of the pool, of the taken buffers and of the released ones.
+         *
+         * @return memory in bytes
+         */
+        [[nodiscard]] size_t CountMemory() const;
+        /**
+         * Free the memory of the released buffers.
+         * The sorting calls it between its phases, since the chunks of the next phase are of another size.
+         */
+        void Trim();
+        /**
+         * Limit the memory of the pool. The released buffers are kept only while all the blocks take at most
+         * `limit` bytes, and a new block frees as many released ones as it needs to fit in the limit.
+         * The taken buffers are not limited, so the pool goes over the limit only if they do.
+         *
+         * @param limit memory in bytes (0 - no limit)
+         */
+        void SetLimit(size_t limit);
+
+        /**
+         * Count the memory of the block the buffer of `capacity` numbers takes.
+         *
+         * @param capacity count of numbers
+         * @param huge_pages the buffers of at least a huge page are aligned to it
+         * @return memory in bytes
+         */
+        static size_t CountBlockMemory(size_t capacity, bool huge_pages);
+
+        /**
+         * Alignment of the memory of the buffers, the cache line.
+         */
+        static constexpr size_t kAlignment = 64;
+        /**
+         * Size of a transparent huge page.
+         */
+        static constexpr size_t kHugePageSize = size_t{2} << 20;
+
+    private:
+        friend class ChunkBuffer;
+
+        /**
+         * Memory of a buffer.
+         */
+        struct Block {
+            /**
+             * First number of the memory.
+             */
+            NumberType *data_ = nullptr;
+            /**
+             * Count of numbers the memory holds.
+             */
+            size_t capacity_ = 0;
+        };
+
+        /**
+         * Take the memory for at least `capacity` numbers: the smallest released block which is big enough,
+         * or a new one. The new block replaces the biggest released one, which is freed,
+         * and the smaller released blocks are kept for the smaller buffers while they fit in the limit.
+         *
+         * @param capacity count of numbers
+         * @return memory of the buffer
+         */
+        Block Take(size_t capacity);
+        /**
+         * Give the memory of a buffer back to the pool. It is freed if the pool is over the limit.
+         *
+         * @param block memory of the buffer
+         */
+        void Give(Block block);
+
+        /**
+         * Allocate aligned memory for at least `capacity` numbers.
+         * Throws std::bad_alloc if there is no memory.
+         *
+         * @param capacity count of numbers
+         * @param huge_pages align the memory to huge pages and back it by them if it takes at least one
+         * @return allocated memory
+         */
+        static Block Allocate(size_t capacity, bool huge_pages);
+        /**
+         * Free the memory of a block.
+         *
+         * @param block memory to free
+         */
+        static void Free(Block block);
+
+        /**
+         * The big buffers are backed by huge pages.
+         */
+        bool huge_pages_ = false;
+        /**
+         * Guards free_, allocations_ and memory_.
+         */
+        mutable std::mutex mutex_;
+        /**
+         * Memory of the released buffers.
+         */
+        std::vector<Block> free_;
+        /**
+         * Count of the allocated blocks.
+         */
+        size_t allocations_ = 0;
+        /**
+         * Memory of the blocks which are not freed in bytes.
+         */
+        size_t memory_ = 0;
+        /**
+         * Limit of memory_ for keeping the released blocks (0 - no limit).
+         */
+        size_t limit_ = 0;
+    };
+} // namespace tape_structure
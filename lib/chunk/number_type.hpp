@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+namespace tape_structure {
+    /**
+     * Type of the numbers on the tapes (the TAPE_STRUCTURE_NUMBER_TYPE build option):
+     * int32_t (by default), uint32_t, int64_t, uint64_t, float or double.
+     * Records (a key with a payload) are not supported, the numbers are compared as a whole.
+     */
+#ifdef TAPE_STRUCTURE_NUMBER_TYPE
+    using NumberType = TAPE_STRUCTURE_NUMBER_TYPE;
+#else
+    using NumberType = int32_t;
+#endif
+    static_assert(std::is_arithmetic_v<NumberType> && (sizeof(NumberType) == 4 || sizeof(NumberType) == 8),
+                  "Numbers on the tapes are 32-bit or 64-bit integers or floating-point numbers");
+    using ChunkSize = uint64_t;
+    using ChunksCount = uint64_t;
+} // namespace tape_structure
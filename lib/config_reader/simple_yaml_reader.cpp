@@ -1,5 +1,7 @@
 #include "simple_yaml_reader.hpp"
 
+#include <stdexcept>
+
 namespace config_reader {
     SimpleYamlReader::SimpleYamlReader(const char *path)
         : path_(path) {}
@@ -53,6 +55,14 @@ namespace config_reader {
         return std::stoi(value_);
     }
 
+    [[nodiscard]] uint64_t SimpleYamlReader::Value::AsUInt64() const {
+        // std::stoull accepts a minus sign and wraps the negative number around.
+        if (value_.find('-') != std::string::npos) {
+            throw std::out_of_range("Negative value of an unsigned field: " + value_);
+        }
+        return std::stoull(value_);
+    }
+
     [[nodiscard]] long long SimpleYamlReader::Value::AsLongLong() const {
         return std::stoll(value_);
     }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <string>
@@ -25,6 +26,7 @@ namespace config_reader {
             [[nodiscard]] std::filesystem::path AsPath() const;
             [[nodiscard]] std::string AsString() const;
             [[nodiscard]] int32_t AsInt32() const;
+            [[nodiscard]] uint64_t AsUInt64() const;
             [[nodiscard]] long long AsLongLong() const;
             [[nodiscard]] long AsLong() const;
             [[nodiscard]] double AsDouble() const;
@@ -1,9 +1,87 @@
 #include "delays.hpp"
 
+#include <stdexcept>
+#include <string>
+#include <thread>
+
 namespace tape_structure {
+    DelayMode ParseDelayMode(std::string_view name) {
+        if (name.empty() || name == "sleep") {
+            return DelayMode::kSleep;
+        }
+        if (name == "virtual") {
+            return DelayMode::kVirtual;
+        }
+        throw std::invalid_argument("Unknown delay mode: " + std::string(name));
+    }
+
     Delays::Delays(std::chrono::milliseconds delay_for_read,
                    std::chrono::milliseconds delay_for_put,
-                   std::chrono::milliseconds delay_for_shift) : delay_for_read_(delay_for_read),
-                                                                delay_for_put_(delay_for_put),
-                                                                delay_for_shift_(delay_for_shift) {}
-} // namespace tape_structure
\ No newline at end of file
+                   std::chrono::milliseconds delay_for_shift,
+                   DelayMode mode,
+                   std::chrono::milliseconds sleep_batch) : delay_for_read_(delay_for_read),
+                                                            delay_for_put_(delay_for_put),
+                                                            delay_for_shift_(delay_for_shift),
+                                                            mode_(mode),
+                                                            sleep_batch_(sleep_batch),
+                                                            total_clock_(std::make_shared<DelayClock>()) {
+        if (!kEmulateDelays && (delay_for_read_ != 0ms || delay_for_put_ != 0ms || delay_for_shift_ != 0ms)) {
+            throw std::invalid_argument("Delays are not emulated in this build (TAPE_STRUCTURE_EMULATE_DELAYS)");
+        }
+    }
+
+    void Delays::Spend(std::chrono::milliseconds delay, uint64_t count) const {
+        int64_t cost = delay.count() * static_cast<int64_t>(count);
+        if (clock_) {
+            clock_->elapsed_ += cost;
+        }
+        if (total_clock_) {
+            total_clock_->elapsed_ += cost;
+        }
+
+        if (mode_ == DelayMode::kSleep) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(cost));
+            return;
+        }
+        if (sleep_batch_ == 0ms || !clock_) {
+            return;
+        }
+        if (clock_->unslept_ += cost; clock_->unslept_ >= sleep_batch_.count()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(clock_->unslept_.exchange(0)));
+        }
+    }
+
+    void Delays::SpendShifts(uint64_t count) const {
+        if (clock_) {
+            clock_->shifts_ += count;
+        }
+        if (total_clock_) {
+            total_clock_->shifts_ += count;
+        }
+        Spend(delay_for_shift_, count);
+    }
+
+    Delays Delays::ForTape() const {
+        Delays delays = *this;
+        if constexpr (kEmulateDelays) {
+            delays.clock_ = std::make_shared<DelayClock>();
+        }
+        return delays;
+    }
+
+    std::chrono::milliseconds Delays::GetElapsed() const {
+        return std::chrono::milliseconds(clock_ ? clock_->elapsed_.load() : 0);
+    }
+
+    std::chrono::milliseconds Delays::GetTotalElapsed() const {
+        return std::chrono::milliseconds(total_clock_ ? total_clock_->elapsed_.load() : 0);
+    }
+
+    uint64_t Delays::GetShifts() const {
+        return clock_ ? clock_->shifts_.load() : 0;
+    }
+
+    uint64_t Delays::GetTotalShifts() const {
+        return total_clock_ ? total_clock_->shifts_.load() : 0;
+    }
+} // namespace tape_structure
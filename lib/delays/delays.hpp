@@ -1,19 +1,142 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <future>
+#include <memory>
+#include <string_view>
 
 namespace tape_structure {
     using namespace std::chrono_literals;
 
+    /**
+     * Whether the delays of the tape device are emulated (the TAPE_STRUCTURE_EMULATE_DELAYS build option).
+     * Without it the delays are compiled out of the operations of the tapes, and only zero delays are accepted.
+     */
+#ifdef TAPE_STRUCTURE_EMULATE_DELAYS
+    constexpr bool kEmulateDelays = true;
+#else
+    constexpr bool kEmulateDelays = false;
+#endif
+
+    /**
+     * The way the delays are spent.
+     */
+    enum class DelayMode {
+        /**
+         * The thread sleeps for every delay.
+         */
+        kSleep,
+        /**
+         * The delays are only added to the simulated time of the tapes
+         * (and are slept once per batch if the batch is set).
+         */
+        kVirtual,
+    };
+
+    /**
+     * Parse the delay mode from its name in the config (`sleep` or `virtual`, `sleep` if it is empty).
+     * Throws std::invalid_argument for an unknown name.
+     *
+     * @param name name of the mode
+     * @return delay mode
+     */
+    DelayMode ParseDelayMode(std::string_view name);
+
+    /**
+     * Simulated time of the operations, it is shared by all the copies of the delays it belongs to.
+     */
+    struct DelayClock {
+        /**
+         * Simulated time in milliseconds.
+         */
+        std::atomic<int64_t> elapsed_{};
+        /**
+         * Simulated time in milliseconds which is not slept yet in the virtual mode.
+         */
+        std::atomic<int64_t> unslept_{};
+        /**
+         * Count of the positions the tape has moved by.
+         */
+        std::atomic<uint64_t> shifts_{};
+    };
+
     /**
      * Delays for processes.
+     * The delays are counted by the clock of the tape and by the clock of all the tapes
+     * created from the same delays (see ForTape).
+     * Throws std::invalid_argument if a delay is not zero and the delays are not emulated (see kEmulateDelays).
      */
     struct Delays {
         Delays() = default;
         Delays(std::chrono::milliseconds delay_for_read,
                std::chrono::milliseconds delay_for_put,
-               std::chrono::milliseconds delay_for_shift);
+               std::chrono::milliseconds delay_for_shift,
+               DelayMode mode = DelayMode::kSleep,
+               std::chrono::milliseconds sleep_batch = 0ms);
+
+        /**
+         * Spend the delay of the operation repeated several times.
+         * The sleep mode sleeps for all of them at once; the virtual mode only adds them to the clocks
+         * and sleeps when the time not slept reaches the batch.
+         *
+         * It is inline, so nothing is left of it in the operations of the tapes without kEmulateDelays
+         * and only the check of the delay is left with zero delays.
+         *
+         * @param delay delay of one operation
+         * @param count count of the operations
+         */
+        void Wait(std::chrono::milliseconds delay, uint64_t count = 1) const {
+            if constexpr (kEmulateDelays) {
+                if (delay != 0ms && count != 0) {
+                    Spend(delay, count);
+                }
+            }
+        }
+        /**
+         * Spend the delay for moving the tape by several positions and count the positions.
+         * The positions are counted only if the delay for shift is set.
+         *
+         * @param count count of the positions
+         */
+        void Shift(uint64_t count = 1) const {
+            if constexpr (kEmulateDelays) {
+                if (delay_for_shift_ != 0ms && count != 0) {
+                    SpendShifts(count);
+                }
+            }
+        }
+        /**
+         * Copy the delays for a new tape: the tape gets its own clock and shares the clock of all the tapes.
+         *
+         * @return delays of the new tape
+         */
+        [[nodiscard]] Delays ForTape() const;
+        /**
+         * Get the simulated time of the operations of the tape.
+         *
+         * @return simulated time
+         */
+        [[nodiscard]] std::chrono::milliseconds GetElapsed() const;
+        /**
+         * Get the simulated time of the operations of all the tapes created from the same delays.
+         *
+         * @return simulated time
+         */
+        [[nodiscard]] std::chrono::milliseconds GetTotalElapsed() const;
+        /**
+         * Get the count of the positions the tape has moved by.
+         *
+         * @return count of the positions
+         */
+        [[nodiscard]] uint64_t GetShifts() const;
+        /**
+         * Get the count of the positions all the tapes created from the same delays have moved by.
+         *
+         * @return count of the positions
+         */
+        [[nodiscard]] uint64_t GetTotalShifts() const;
 
         /**
          * Delay in reading the number indicated by the magnetic head.
@@ -27,5 +150,37 @@ namespace tape_structure {
          * Delay for moving the tape by one position.
          */
         std::chrono::milliseconds delay_for_shift_{};
+        /**
+         * The way the delays are spent.
+         */
+        DelayMode mode_{DelayMode::kSleep};
+        /**
+         * Simulated time slept at once in the virtual mode (0 - never sleep).
+         */
+        std::chrono::milliseconds sleep_batch_{};
+
+    private:
+        /**
+         * Spend the non-zero delay of the operation repeated several times (see Wait).
+         *
+         * @param delay delay of one operation
+         * @param count count of the operations
+         */
+        void Spend(std::chrono::milliseconds delay, uint64_t count) const;
+        /**
+         * Count the positions and spend the delay for moving by them (see Shift).
+         *
+         * @param count count of the positions
+         */
+        void SpendShifts(uint64_t count) const;
+
+        /**
+         * Clock of the tape.
+         */
+        std::shared_ptr<DelayClock> clock_;
+        /**
+         * Clock of all the tapes created from the same delays.
+         */
+        std::shared_ptr<DelayClock> total_clock_;
     };
-} // namespace tape_structure
\ No newline at end of file
+} // namespace tape_structure
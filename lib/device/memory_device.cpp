@@ -0,0 +1,56 @@
+#include "memory_device.hpp"
+
+#include <algorithm>
+
+namespace tape_structure {
+    MemoryDevice::MemoryDevice() : MemoryDevice(std::make_shared<std::vector<NumberType>>()) {}
+
+    MemoryDevice::MemoryDevice(std::shared_ptr<std::vector<NumberType>> numbers) : numbers_(std::move(numbers)) {}
+
+    void MemoryDevice::Open(TapeSize size, ChunkSize max_chunk_size) {
+        if (numbers_->size() < size) {
+            numbers_->resize(size);
+        }
+        max_chunk_size_ = max_chunk_size;
+        open_ = true;
+    }
+
+    void MemoryDevice::Create(TapeSize size, ChunkSize max_chunk_size) {
+        numbers_->assign(size, 0);
+        Open(size, max_chunk_size);
+    }
+
+    bool MemoryDevice::IsOpen() const {
+        return open_;
+    }
+
+    void MemoryDevice::Truncate(TapeSize size) {
+        numbers_->resize(size);
+        numbers_->shrink_to_fit();
+    }
+
+    void MemoryDevice::ReadChunk(ChunksCount chunk_number, std::span<NumberType> numbers) {
+        const NumberType *chunk = MapChunk(chunk_number);
+        std::copy(chunk, chunk + numbers.size(), numbers.begin());
+    }
+
+    void MemoryDevice::WriteChunk(ChunksCount chunk_number, std::span<const NumberType> numbers) {
+        std::copy(numbers.begin(), numbers.end(), MapChunk(chunk_number));
+    }
+
+    NumberType *MemoryDevice::MapChunk(ChunksCount chunk_number) {
+        return numbers_->data() + chunk_number * max_chunk_size_;
+    }
+
+    std::unique_ptr<TapeDevice> MemoryDevice::Share() const {
+        return std::make_unique<MemoryDevice>(numbers_);
+    }
+
+    TapeFormat MemoryDevice::GetFormat() const {
+        return TapeFormat::kBinary;
+    }
+
+    TapeStorage MemoryDevice::GetStorage() const {
+        return TapeStorage::kMemory;
+    }
+} // namespace tape_structure
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "tape_device.hpp"
+
+namespace tape_structure {
+    /**
+     * Tape kept in RAM.
+     * Chunks are windows into the numbers, so they are neither read nor written.
+     * Devices made by Share() see the same numbers.
+     */
+    class MemoryDevice : public TapeDevice {
+    public:
+        MemoryDevice();
+        explicit MemoryDevice(std::shared_ptr<std::vector<NumberType>> numbers);
+
+        void Open(TapeSize size, ChunkSize max_chunk_size) override;
+        void Create(TapeSize size, ChunkSize max_chunk_size) override;
+        [[nodiscard]] bool IsOpen() const override;
+        void Truncate(TapeSize size) override;
+
+        void ReadChunk(ChunksCount chunk_number, std::span<NumberType> numbers) override;
+        void WriteChunk(ChunksCount chunk_number, std::span<const NumberType> numbers) override;
+        NumberType *MapChunk(ChunksCount chunk_number) override;
+
+        [[nodiscard]] std::unique_ptr<TapeDevice> Share() const override;
+        [[nodiscard]] TapeFormat GetFormat() const override;
+        [[nodiscard]] TapeStorage GetStorage() const override;
+
+    private:
+        /**
+         * Numbers of the tape shared by all devices over the same storage.
+         */
+        std::shared_ptr<std::vector<NumberType>> numbers_;
+        /**
+         * Size of all chunks except the last one.
+         */
+        ChunkSize max_chunk_size_{};
+        /**
+         * The device is open.
+         */
+        bool open_ = false;
+    };
+} // namespace tape_structure
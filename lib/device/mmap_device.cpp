@@ -0,0 +1,77 @@
+#include "mmap_device.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace tape_structure {
+    MmapDevice::MmapDevice(std::filesystem::path path) : path_(std::move(path)) {}
+
+    void MmapDevice::Open(TapeSize size, ChunkSize max_chunk_size) {
+        if (!exists(path_) || std::filesystem::file_size(path_) == 0) {
+            std::ofstream header(path_, std::ios::binary);
+            binary_format::WriteHeader(header, {sizeof(NumberType), size});
+        }
+        std::ifstream header(path_, std::ios::binary);
+        if (binary_format::ReadHeader(header).element_width_ != sizeof(NumberType)) {
+            throw std::runtime_error("Element width of the tape file does not match the type of numbers");
+        }
+
+        max_chunk_size_ = max_chunk_size;
+        mapping_.Open(path_, binary_format::OffsetOf(size, sizeof(NumberType)));
+        if (sequential_) {
+            mapping_.AdviseSequential();
+        }
+    }
+
+    void MmapDevice::Create(TapeSize size, ChunkSize max_chunk_size) {
+        mapping_.Close();
+        std::ofstream(path_, std::ios::trunc);
+        Open(size, max_chunk_size);
+    }
+
+    bool MmapDevice::IsOpen() const {
+        return mapping_.IsOpen();
+    }
+
+    void MmapDevice::Truncate(TapeSize size) {
+        mapping_.Close();
+        std::filesystem::resize_file(path_, binary_format::OffsetOf(size, sizeof(NumberType)));
+        {
+            std::fstream header(path_, std::ios::in | std::ios::out | std::ios::binary);
+            binary_format::WriteHeader(header, {sizeof(NumberType), size});
+        }
+        Open(size, max_chunk_size_);
+    }
+
+    void MmapDevice::ReadChunk(ChunksCount chunk_number, std::span<NumberType> numbers) {
+        const NumberType *chunk = MapChunk(chunk_number);
+        std::copy(chunk, chunk + numbers.size(), numbers.begin());
+    }
+
+    void MmapDevice::WriteChunk(ChunksCount chunk_number, std::span<const NumberType> numbers) {
+        std::copy(numbers.begin(), numbers.end(), MapChunk(chunk_number));
+    }
+
+    NumberType *MmapDevice::MapChunk(ChunksCount chunk_number) {
+        return reinterpret_cast<NumberType *>(mapping_.GetData() + binary_format::kHeaderSize) +
+               chunk_number * max_chunk_size_;
+    }
+
+    void MmapDevice::AdviseSequential() {
+        sequential_ = true;
+        mapping_.AdviseSequential();
+    }
+
+    std::unique_ptr<TapeDevice> MmapDevice::Share() const {
+        return std::make_unique<MmapDevice>(path_);
+    }
+
+    TapeFormat MmapDevice::GetFormat() const {
+        return TapeFormat::kBinary;
+    }
+
+    TapeStorage MmapDevice::GetStorage() const {
+        return TapeStorage::kMmap;
+    }
+} // namespace tape_structure
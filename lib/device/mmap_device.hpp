@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../mapping/mapped_file.hpp"
+#include "tape_device.hpp"
+
+namespace tape_structure {
+    /**
+     * Binary tape file mapped into memory.
+     * Chunks are windows into the mapping, so they are neither read nor written.
+     */
+    class MmapDevice : public TapeDevice {
+    public:
+        explicit MmapDevice(std::filesystem::path path);
+
+        void Open(TapeSize size, ChunkSize max_chunk_size) override;
+        void Create(TapeSize size, ChunkSize max_chunk_size) override;
+        [[nodiscard]] bool IsOpen() const override;
+        void Truncate(TapeSize size) override;
+
+        void ReadChunk(ChunksCount chunk_number, std::span<NumberType> numbers) override;
+        void WriteChunk(ChunksCount chunk_number, std::span<const NumberType> numbers) override;
+        NumberType *MapChunk(ChunksCount chunk_number) override;
+
+        void AdviseSequential() override;
+
+        [[nodiscard]] std::unique_ptr<TapeDevice> Share() const override;
+        [[nodiscard]] TapeFormat GetFormat() const override;
+        [[nodiscard]] TapeStorage GetStorage() const override;
+
+    private:
+        /**
+         * Path to the file where the tape is located.
+         */
+        std::filesystem::path path_;
+        /**
+         * Memory-mapped file of the tape.
+         */
+        MappedFile mapping_;
+        /**
+         * Size of all chunks except the last one.
+         */
+        ChunkSize max_chunk_size_{};
+        /**
+         * The tape will be passed sequentially.
+         */
+        bool sequential_ = false;
+    };
+} // namespace tape_structure
@@ -0,0 +1,62 @@
+#include "reversed_device.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace tape_structure {
+    ReversedDevice::ReversedDevice(std::unique_ptr<TapeDevice> device, ChunkSize piece_size)
+        : device_(std::move(device)),
+          piece_size_(piece_size) {}
+
+    void ReversedDevice::Open(TapeSize size, ChunkSize max_chunk_size) {
+        size_ = size;
+        max_chunk_size_ = max_chunk_size;
+        block_size_ = std::gcd(piece_size_, max_chunk_size_);
+        device_->Open(size_, block_size_);
+    }
+
+    void ReversedDevice::Create(TapeSize, ChunkSize) {
+        throw std::runtime_error("Reversed tape can not be written");
+    }
+
+    bool ReversedDevice::IsOpen() const {
+        return device_->IsOpen();
+    }
+
+    void ReversedDevice::Truncate(TapeSize) {
+        throw std::runtime_error("Reversed tape can not be written");
+    }
+
+    void ReversedDevice::ReadChunk(ChunksCount chunk_number, std::span<NumberType> numbers) {
+        TapeSize count_of_pieces = size_ / piece_size_;
+        TapeSize begin = chunk_number * max_chunk_size_;
+        for (size_t done = 0; done < numbers.size(); done += block_size_) {
+            TapeSize element = begin + done;
+            TapeSize piece = count_of_pieces - 1 - element / piece_size_;
+            TapeSize stored = piece * piece_size_ + element % piece_size_;
+            device_->ReadChunk(stored / block_size_,
+                               numbers.subspan(done, std::min<size_t>(block_size_, numbers.size() - done)));
+        }
+    }
+
+    void ReversedDevice::WriteChunk(ChunksCount, std::span<const NumberType>) {
+        throw std::runtime_error("Reversed tape can not be written");
+    }
+
+    void ReversedDevice::Flush() {
+        device_->Flush();
+    }
+
+    std::unique_ptr<TapeDevice> ReversedDevice::Share() const {
+        return std::make_unique<ReversedDevice>(device_->Share(), piece_size_);
+    }
+
+    TapeFormat ReversedDevice::GetFormat() const {
+        return device_->GetFormat();
+    }
+
+    TapeStorage ReversedDevice::GetStorage() const {
+        return device_->GetStorage();
+    }
+} // namespace tape_structure
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "tape_device.hpp"
+
+namespace tape_structure {
+    /**
+     * Tape stored on another device by pieces of the same size in the reverse order.
+     * It is used for descending runs: every chunk of the run is reversed when it is written,
+     * so reading the pieces from the last one gives the run in the ascending order.
+     * The tape is only read, its chunks may be of any size.
+     */
+    class ReversedDevice : public TapeDevice {
+    public:
+        /**
+         * @param device device where the pieces are stored one after another, the size of the tape
+         *               is a multiple of the size of the pieces
+         * @param piece_size size of the pieces
+         */
+        ReversedDevice(std::unique_ptr<TapeDevice> device, ChunkSize piece_size);
+
+        void Open(TapeSize size, ChunkSize max_chunk_size) override;
+        void Create(TapeSize size, ChunkSize max_chunk_size) override;
+        [[nodiscard]] bool IsOpen() const override;
+        void Truncate(TapeSize size) override;
+
+        void ReadChunk(ChunksCount chunk_number, std::span<NumberType> numbers) override;
+        void WriteChunk(ChunksCount chunk_number, std::span<const NumberType> numbers) override;
+
+        void Flush() override;
+
+        [[nodiscard]] std::unique_ptr<TapeDevice> Share() const override;
+        [[nodiscard]] TapeFormat GetFormat() const override;
+        [[nodiscard]] TapeStorage GetStorage() const override;
+
+    private:
+        /**
+         * Device where the pieces are stored.
+         * It is read by blocks of the greatest common divisor of the pieces and the chunks,
+         * so every block lies in one piece.
+         */
+        std::unique_ptr<TapeDevice> device_;
+        /**
+         * Size of the pieces.
+         */
+        ChunkSize piece_size_{};
+        /**
+         * Number of elements of the tape.
+         */
+        TapeSize size_{};
+        /**
+         * Size of all chunks except the last one.
+         */
+        ChunkSize max_chunk_size_{};
+        /**
+         * Size of the blocks the device is read by.
+         */
+        ChunkSize block_size_{};
+    };
+} // namespace tape_structure
@@ -0,0 +1,371 @@
+#include "stream_device.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace tape_structure {
+    StreamDevice::StreamDevice(std::filesystem::path path, TapeFormat format) : path_(std::move(path)),
+                                                                                 format_(format) {
+        // The device reads and writes by its own blocks, so the buffer of the stream would be another copy.
+        stream_.rdbuf()->pubsetbuf(nullptr, 0);
+    }
+
+    void StreamDevice::Open(TapeSize size, ChunkSize max_chunk_size) {
+        if (!exists(path_)) {
+            Create(size, max_chunk_size);
+            return;
+        }
+
+        size_ = size;
+        max_chunk_size_ = max_chunk_size;
+        chunk_offsets_ = {format_ == TapeFormat::kCompressed ? compressed_format::kHeaderSize : 0};
+        text_reader_.SetBlockSize(CountBlockSize(max_chunk_size_));
+        block_number_ = kNoBlock;
+        if (format_ == TapeFormat::kCompressed) {
+            block_.resize(kBlockLength);
+        }
+        stream_.close();
+        stream_.open(path_, std::ios::in | std::ios::out | std::ios::binary);
+        if (format_ == TapeFormat::kText || !stream_.is_open()) {
+            return;
+        }
+
+        if (std::filesystem::file_size(path_) == 0) {
+            WriteTapeHeader(stream_, format_, {sizeof(NumberType), size_});
+        } else if (ReadTapeHeader(stream_, format_).element_width_ != sizeof(NumberType)) {
+            throw std::runtime_error("Element width of the tape file does not match the type of numbers");
+        }
+    }
+
+    void StreamDevice::Create(TapeSize size, ChunkSize max_chunk_size) {
+        std::ofstream(path_, std::ios::trunc);
+        Open(size, max_chunk_size);
+    }
+
+    bool StreamDevice::IsOpen() const {
+        return stream_.is_open();
+    }
+
+    void StreamDevice::Truncate(TapeSize size) {
+        std::streamoff end;
+        if (format_ == TapeFormat::kBinary) {
+            end = binary_format::OffsetOf(size, sizeof(NumberType));
+        } else if (format_ == TapeFormat::kCompressed) {
+            end = TruncateBlocks(size);
+        } else {
+            ChunksCount chunk_number = size / max_chunk_size_;
+            end = GetChunkOffset(chunk_number);
+            if (size % max_chunk_size_ != 0) {
+                text_reader_.Seek(end);
+                for (ChunkSize i = 0; i < size % max_chunk_size_; i++) {
+                    NumberType number;
+                    text_reader_.ReadNumber(number);
+                }
+                end = text_reader_.Tell();
+            }
+            text_reader_.Reset();
+            chunk_offsets_.resize(std::min<size_t>(chunk_offsets_.size(), chunk_number + 1));
+        }
+
+        stream_.flush();
+        std::filesystem::resize_file(path_, end);
+        size_ = size;
+        if (format_ != TapeFormat::kText) {
+            stream_.clear();
+            stream_.seekp(0);
+            WriteTapeHeader(stream_, format_, {sizeof(NumberType), size_});
+        }
+    }
+
+    void StreamDevice::ReadChunk(ChunksCount chunk_number, std::span<NumberType> numbers) {
+        if (format_ == TapeFormat::kBinary) {
+            stream_.clear();
+            stream_.seekg(GetChunkOffset(chunk_number));
+            binary_format::ReadNumbers(stream_, numbers.data(), numbers.size());
+            return;
+        }
+        if (format_ == TapeFormat::kCompressed) {
+            ReadBlocks(static_cast<uint64_t>(chunk_number) * max_chunk_size_, numbers);
+            return;
+        }
+
+        text_reader_.Seek(GetChunkOffset(chunk_number));
+        text_reader_.ReadNumbers(numbers.data(), numbers.size());
+        if (chunk_offsets_.size() == chunk_number + 1) {
+            text_reader_.SkipSpaces();
+            chunk_offsets_.push_back(text_reader_.Tell());
+        }
+    }
+
+    void StreamDevice::WriteChunk(ChunksCount chunk_number, std::span<const NumberType> numbers) {
+        if (format_ == TapeFormat::kCompressed) {
+            WriteBlocks(static_cast<uint64_t>(chunk_number) * max_chunk_size_, numbers);
+            return;
+        }
+
+        std::streamoff chunk_begin = GetChunkOffset(chunk_number);
+        stream_.clear();
+
+        if (format_ == TapeFormat::kBinary) {
+            stream_.seekp(chunk_begin);
+            binary_format::WriteNumbers(stream_, numbers.data(), numbers.size());
+            return;
+        }
+
+        std::streamoff chunk_end = GetChunkOffset(chunk_number + 1);
+        text_.reserve(max_chunk_size_ * text_format::kMaxTextLength<NumberType>);
+        text_.clear();
+        text_format::AppendNumbers(text_, numbers.data(), numbers.size());
+        std::streamoff shift = chunk_begin + static_cast<std::streamoff>(text_.size()) - chunk_end;
+        ShiftTail(chunk_end, shift);
+        stream_.seekp(chunk_begin);
+        stream_.write(text_.data(), static_cast<std::streamsize>(text_.size()));
+        text_reader_.Reset();
+
+        for (ChunksCount i = chunk_number + 1; i < chunk_offsets_.size(); i++) {
+            chunk_offsets_[i] += shift;
+        }
+    }
+
+    void StreamDevice::Flush() {
+        stream_.flush();
+    }
+
+    std::unique_ptr<TapeDevice> StreamDevice::Share() const {
+        return std::make_unique<StreamDevice>(path_, format_);
+    }
+
+    TapeFormat StreamDevice::GetFormat() const {
+        return format_;
+    }
+
+    TapeStorage StreamDevice::GetStorage() const {
+        return TapeStorage::kStream;
+    }
+
+    uint64_t StreamDevice::CountMemory(TapeFormat format, ChunkSize max_chunk_size, bool written) {
+        uint64_t block_size = CountBlockSize(max_chunk_size);
+        if (format == TapeFormat::kText) {
+            uint64_t text = written ? max_chunk_size * text_format::kMaxTextLength<NumberType> + block_size : 0;
+            return block_size + text;
+        }
+        if (format == TapeFormat::kCompressed) {
+            uint64_t max_blocks = max_chunk_size / kBlockLength + 2;
+            uint64_t encoded = written ? max_blocks * (compressed_format::kBlockHeaderSize + kMaxEncodedBlockSize +
+                                                       sizeof(std::streamoff)) + block_size
+                                       : 0;
+            return kBlockLength * sizeof(NumberType) + kMaxEncodedBlockSize + encoded;
+        }
+        return 0;
+    }
+
+    uint64_t StreamDevice::CountOffsetsMemory(TapeFormat format, TapeSize size, ChunkSize max_chunk_size) {
+        // The offsets are pushed back one by one, so the vector may take twice as much.
+        if (format == TapeFormat::kText) {
+            return 2 * sizeof(std::streamoff) * (size / max_chunk_size + 2);
+        }
+        if (format == TapeFormat::kCompressed) {
+            return 2 * sizeof(std::streamoff) * (size / kBlockLength + 2);
+        }
+        return 0;
+    }
+
+    size_t StreamDevice::CountBlockSize(ChunkSize max_chunk_size) {
+        return std::clamp<uint64_t>(static_cast<uint64_t>(max_chunk_size) * sizeof(NumberType),
+                                    text_format::TextReader::kMinBlockSize,
+                                    text_format::TextReader::kBlockSize);
+    }
+
+    std::streamoff StreamDevice::GetChunkOffset(ChunksCount chunk_number) {
+        if (format_ == TapeFormat::kBinary) {
+            return binary_format::OffsetOf(chunk_number * max_chunk_size_, sizeof(NumberType));
+        }
+
+        if (chunk_number >= chunk_offsets_.size()) {
+            text_reader_.Seek(chunk_offsets_.back());
+            for (ChunksCount i = chunk_offsets_.size() - 1; i < chunk_number; i++) {
+                for (ChunkSize j = 0; j < GetChunkSize(i); j++) {
+                    NumberType number;
+                    text_reader_.ReadNumber(number);
+                }
+                text_reader_.SkipSpaces();
+                chunk_offsets_.push_back(text_reader_.Tell());
+            }
+        }
+        return chunk_offsets_[chunk_number];
+    }
+
+    void StreamDevice::ScanBlocks(uint64_t count) {
+        while (chunk_offsets_.size() <= count) {
+            stream_.clear();
+            stream_.seekg(chunk_offsets_.back());
+            compressed_format::BlockHeader header = compressed_format::ReadBlockHeader(stream_);
+            if (header.count_ == 0) {
+                return;
+            }
+            chunk_offsets_.push_back(chunk_offsets_.back() + compressed_format::kBlockHeaderSize + header.size_);
+        }
+    }
+
+    bool StreamDevice::LoadBlock(uint64_t block_number) {
+        if (block_number == block_number_) {
+            return true;
+        }
+        ScanBlocks(block_number);
+        if (chunk_offsets_.size() <= block_number) {
+            return false;
+        }
+
+        stream_.clear();
+        if (stream_.tellg() != chunk_offsets_[block_number]) {
+            // The blocks read one after another are not sought, the stream is already after the previous one.
+            stream_.seekg(chunk_offsets_[block_number]);
+        }
+        encoded_.reserve(kMaxEncodedBlockSize);
+        compressed_format::BlockHeader header = compressed_format::ReadBlock(stream_, encoded_, block_.data());
+        if (header.count_ == 0) {
+            return false;
+        }
+        if (chunk_offsets_.size() == block_number + 1) {
+            chunk_offsets_.push_back(chunk_offsets_.back() + compressed_format::kBlockHeaderSize + header.size_);
+        }
+        std::fill(block_.begin() + header.count_, block_.end(), 0);
+        block_number_ = block_number;
+        block_count_ = header.count_;
+        return true;
+    }
+
+    void StreamDevice::ReadBlocks(uint64_t first, std::span<NumberType> numbers) {
+        size_t read = 0;
+        for (uint64_t block = first / kBlockLength; read < numbers.size() && LoadBlock(block); block++) {
+            size_t begin = first + read - block * kBlockLength;
+            size_t count = std::min(numbers.size() - read, kBlockLength - begin);
+            std::copy_n(block_.begin() + static_cast<std::ptrdiff_t>(begin), count, numbers.begin() + read);
+            read += count;
+        }
+        std::fill(numbers.begin() + read, numbers.end(), 0);
+    }
+
+    void StreamDevice::WriteBlocks(uint64_t first, std::span<const NumberType> numbers) {
+        if (numbers.empty()) {
+            return;
+        }
+        uint64_t first_block = first / kBlockLength;
+        uint64_t last_block = (first + numbers.size() - 1) / kBlockLength;
+        ScanBlocks(last_block + 1);
+        uint64_t stored = chunk_offsets_.size() - 1;
+
+        // The blocks missing before the first written one are filled with zeros.
+        uint64_t begin_block = std::min(first_block, stored);
+        // The buffers are reserved for the biggest chunk at once, so they do not grow by doubling.
+        size_t max_blocks = max_chunk_size_ / kBlockLength + 2;
+        text_.reserve(max_blocks * (compressed_format::kBlockHeaderSize + kMaxEncodedBlockSize));
+        block_ends_.reserve(max_blocks);
+        text_.clear();
+        block_ends_.clear();
+        for (uint64_t block = begin_block; block <= last_block; block++) {
+            uint64_t block_begin = block * kBlockLength;
+            uint64_t from = std::clamp(first, block_begin, block_begin + kBlockLength);
+            uint64_t to = std::min(first + numbers.size(), block_begin + kBlockLength);
+            const NumberType *data = numbers.data() + (from - first);
+            size_t count = to - from;
+            if (from != block_begin || (block < stored && to != block_begin + kBlockLength)) {
+                // The block is written partly, the rest of its numbers are kept.
+                if (!LoadBlock(block)) {
+                    std::fill(block_.begin(), block_.end(), 0);
+                    block_count_ = 0;
+                }
+                std::copy_n(data, count, block_.begin() + static_cast<std::ptrdiff_t>(from - block_begin));
+                count = std::max<size_t>(block_count_, to - block_begin);
+                data = block_.data();
+            }
+            compressed_format::AppendBlock(text_, data, count);
+            block_ends_.push_back(static_cast<std::streamoff>(text_.size()));
+        }
+        block_number_ = kNoBlock;
+
+        uint64_t end_block = std::min(last_block + 1, stored);
+        std::streamoff begin = chunk_offsets_[begin_block];
+        std::streamoff end = chunk_offsets_[end_block];
+        std::streamoff shift = begin + static_cast<std::streamoff>(text_.size()) - end;
+        ShiftTail(end, shift);
+        stream_.clear();
+        stream_.seekp(begin);
+        stream_.write(text_.data(), static_cast<std::streamsize>(text_.size()));
+
+        for (uint64_t i = end_block + 1; i < chunk_offsets_.size(); i++) {
+            chunk_offsets_[i] += shift;
+        }
+        for (std::streamoff &block_end: block_ends_) {
+            block_end += begin;
+        }
+        chunk_offsets_.erase(chunk_offsets_.begin() + static_cast<std::ptrdiff_t>(begin_block + 1),
+                             chunk_offsets_.begin() + static_cast<std::ptrdiff_t>(end_block + 1));
+        chunk_offsets_.insert(chunk_offsets_.begin() + static_cast<std::ptrdiff_t>(begin_block + 1),
+                              block_ends_.begin(), block_ends_.end());
+    }
+
+    std::streamoff StreamDevice::TruncateBlocks(TapeSize size) {
+        uint64_t blocks = (static_cast<uint64_t>(size) + kBlockLength - 1) / kBlockLength;
+        ScanBlocks(blocks);
+        if (chunk_offsets_.size() <= blocks) {
+            return chunk_offsets_.back();
+        }
+
+        std::streamoff end = chunk_offsets_[blocks];
+        size_t last_count = size % kBlockLength;
+        if (last_count != 0 && LoadBlock(blocks - 1) && block_count_ > last_count) {
+            // The differences of the kept numbers do not change, so the block only becomes shorter.
+            text_.clear();
+            compressed_format::AppendBlock(text_, block_.data(), last_count);
+            stream_.clear();
+            stream_.seekp(chunk_offsets_[blocks - 1]);
+            stream_.write(text_.data(), static_cast<std::streamsize>(text_.size()));
+            end = chunk_offsets_[blocks - 1] + static_cast<std::streamoff>(text_.size());
+        }
+        chunk_offsets_.resize(blocks + 1);
+        chunk_offsets_[blocks] = end;
+        block_number_ = kNoBlock;
+        return end;
+    }
+
+    ChunkSize StreamDevice::GetChunkSize(ChunksCount chunk_number) const {
+        ChunksCount count_of_chunks = (size_ - 1) / max_chunk_size_ + 1;
+        return chunk_number == count_of_chunks - 1
+                       ? size_ - chunk_number * max_chunk_size_
+                       : max_chunk_size_;
+    }
+
+    void StreamDevice::ShiftTail(std::streamoff from, std::streamoff shift) {
+        if (shift == 0) {
+            return;
+        }
+
+        stream_.seekg(0, std::ios::end);
+        std::streamoff file_end = stream_.tellg();
+        std::vector<char> block(CountBlockSize(max_chunk_size_));
+        auto block_size = static_cast<std::streamoff>(block.size());
+        auto move_block = [&](std::streamoff begin, std::streamoff end) {
+            stream_.seekg(begin);
+            stream_.read(block.data(), end - begin);
+            stream_.seekp(begin + shift);
+            stream_.write(block.data(), end - begin);
+        };
+
+        if (shift > 0) {
+            for (std::streamoff end = file_end; end > from;) {
+                std::streamoff begin = std::max(from, end - block_size);
+                move_block(begin, end);
+                end = begin;
+            }
+        } else {
+            for (std::streamoff begin = from; begin < file_end;) {
+                std::streamoff end = std::min(file_end, begin + block_size);
+                move_block(begin, end);
+                begin = end;
+            }
+            stream_.flush();
+            std::filesystem::resize_file(path_, file_end + shift);
+        }
+    }
+} // namespace tape_structure
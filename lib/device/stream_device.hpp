@@ -0,0 +1,201 @@
+#pragma once
+
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "tape_device.hpp"
+
+namespace tape_structure {
+    /**
+     * Tape stored in a file and accessed through a file stream.
+     */
+    class StreamDevice : public TapeDevice {
+    public:
+        StreamDevice(std::filesystem::path path, TapeFormat format);
+
+        void Open(TapeSize size, ChunkSize max_chunk_size) override;
+        void Create(TapeSize size, ChunkSize max_chunk_size) override;
+        [[nodiscard]] bool IsOpen() const override;
+        void Truncate(TapeSize size) override;
+
+        void ReadChunk(ChunksCount chunk_number, std::span<NumberType> numbers) override;
+        /**
+         * Write the chunk.
+         * Binary chunks are overwritten in place. Text chunks and compressed blocks are spliced in,
+         * and the rest of the file is shifted if their length has changed.
+         *
+         * @param chunk_number number of the chunk
+         * @param numbers numbers of the chunk
+         */
+        void WriteChunk(ChunksCount chunk_number, std::span<const NumberType> numbers) override;
+
+        void Flush() override;
+
+        [[nodiscard]] std::unique_ptr<TapeDevice> Share() const override;
+        [[nodiscard]] TapeFormat GetFormat() const override;
+        [[nodiscard]] TapeStorage GetStorage() const override;
+
+        /**
+         * Count the memory the buffers of the open device take at most.
+         * The file stream is not buffered, the device reads and writes it by its own blocks:
+         * the text tape is parsed by blocks of CountBlockSize, the written chunk is printed or encoded whole,
+         * the tail of the file is shifted by blocks of CountBlockSize and the compressed tape keeps one decoded block.
+         * The offsets of the chunks are counted by CountOffsetsMemory.
+         *
+         * @param format format of the tape
+         * @param max_chunk_size size of all chunks except the last one
+         * @param written the chunks are written, not only read
+         * @return memory in bytes
+         */
+        static uint64_t CountMemory(TapeFormat format, ChunkSize max_chunk_size, bool written);
+        /**
+         * Count the memory the known offsets of the chunks of the text tape
+         * or of the blocks of the compressed tape take at most.
+         *
+         * @param format format of the tape
+         * @param size number of elements of the tape
+         * @param max_chunk_size size of all chunks except the last one
+         * @return memory in bytes
+         */
+        static uint64_t CountOffsetsMemory(TapeFormat format, TapeSize size, ChunkSize max_chunk_size);
+        /**
+         * Count the size of the blocks the text tape is parsed by and the tail of the file is shifted by:
+         * the size of the chunk in the binary format, from TextReader::kMinBlockSize to TextReader::kBlockSize.
+         *
+         * @param max_chunk_size size of all chunks except the last one
+         * @return size of the blocks in bytes
+         */
+        static size_t CountBlockSize(ChunkSize max_chunk_size);
+
+    private:
+        /**
+         * Get the offset of the chunk in the file.
+         * If the offset of the text chunk is not known yet,
+         * the tape is scanned from the last known chunk boundary.
+         *
+         * @param chunk_number number of the chunk
+         * @return offset in bytes from the beginning of the file
+         */
+        std::streamoff GetChunkOffset(ChunksCount chunk_number);
+        /**
+         * Get the size of the chunk by its number.
+         *
+         * @param chunk_number number of the chunk
+         * @return size of the chunk
+         */
+        [[nodiscard]] ChunkSize GetChunkSize(ChunksCount chunk_number) const;
+        /**
+         * Shift the end of the tape file.
+         *
+         * @param from offset of the first byte to shift
+         * @param shift number of bytes to shift by (negative to the beginning of the file)
+         */
+        void ShiftTail(std::streamoff from, std::streamoff shift);
+
+        /**
+         * Find the offsets of the blocks of the compressed tape by their headers.
+         * Then there are count + 1 offsets known unless the tape has fewer blocks.
+         *
+         * @param count count of blocks whose ends should be known
+         */
+        void ScanBlocks(uint64_t count);
+        /**
+         * Decode the block of the compressed tape into block_, unless it is there already.
+         *
+         * @param block_number number of the block
+         * @return false if the tape has no such block
+         */
+        bool LoadBlock(uint64_t block_number);
+        /**
+         * Read the numbers of the compressed tape. Missing numbers are read as zeros.
+         *
+         * @param first index of the first number
+         * @param numbers where the numbers are read to
+         */
+        void ReadBlocks(uint64_t first, std::span<NumberType> numbers);
+        /**
+         * Write the numbers to the compressed tape. The blocks written whole are encoded right from the numbers,
+         * the blocks written partly are decoded first.
+         *
+         * @param first index of the first number
+         * @param numbers numbers to write
+         */
+        void WriteBlocks(uint64_t first, std::span<const NumberType> numbers);
+        /**
+         * Cut the blocks of the compressed tape after the first `size` numbers.
+         *
+         * @param size count of numbers kept
+         * @return new size of the file
+         */
+        std::streamoff TruncateBlocks(TapeSize size);
+
+        /**
+         * Path to the file where the tape is located.
+         */
+        std::filesystem::path path_;
+        /**
+         * Format of the file where the tape is located.
+         */
+        TapeFormat format_;
+        /**
+         * File stream of the tape.
+         */
+        std::fstream stream_;
+        /**
+         * Reader of the numbers of the text tape. It keeps the last block read,
+         * so the chunks read one after another are parsed from memory. Its blocks are of CountBlockSize.
+         */
+        text_format::TextReader text_reader_{stream_};
+        /**
+         * Buffer where the written chunk is printed as text or encoded as compressed blocks.
+         */
+        std::string text_;
+        /**
+         * Buffer for the encoded numbers of the compressed block being read.
+         */
+        std::string encoded_;
+        /**
+         * Numbers of the last decoded block of the compressed tape, it is empty for the other formats.
+         */
+        std::vector<NumberType> block_;
+        /**
+         * Number of the block in block_.
+         */
+        uint64_t block_number_ = kNoBlock;
+        /**
+         * Count of numbers stored in the block in block_.
+         */
+        size_t block_count_{};
+        /**
+         * Ends of the compressed blocks being written, relative to the first one.
+         */
+        std::vector<std::streamoff> block_ends_;
+
+        /**
+         * Number of elements of the tape.
+         */
+        TapeSize size_{};
+        /**
+         * Size of all chunks except the last one.
+         */
+        ChunkSize max_chunk_size_{};
+        /**
+         * Offsets of the chunk boundaries in the text tape file known so far.
+         * The i-th element is the offset of the i-th chunk.
+         * It is filled in during the first pass to the right,
+         * so that moving to the left chunk does not rescan the tape from the beginning.
+         * The compressed tape keeps the offsets of its blocks here, the last one is the end of the last known block.
+         * The offsets of the binary chunks are calculated, so it is not used for them.
+         */
+        std::vector<std::streamoff> chunk_offsets_ = {0};
+
+        static constexpr size_t kBlockLength = compressed_format::kBlockLength;
+        /**
+         * Size of the encoded numbers of a block of the compressed tape at most.
+         */
+        static constexpr size_t kMaxEncodedBlockSize = kBlockLength * compressed_format::kMaxDifferenceSize<NumberType>;
+        static constexpr uint64_t kNoBlock = std::numeric_limits<uint64_t>::max();
+    };
+} // namespace tape_structure
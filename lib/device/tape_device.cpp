@@ -0,0 +1,48 @@
+#include "tape_device.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include "memory_device.hpp"
+#include "mmap_device.hpp"
+#include "stream_device.hpp"
+
+namespace tape_structure {
+    NumberType *TapeDevice::MapChunk(ChunksCount) {
+        return nullptr;
+    }
+
+    void TapeDevice::Flush() {}
+
+    void TapeDevice::AdviseSequential() {}
+
+    TapeStorage ParseTapeStorage(std::string_view name) {
+        if (name.empty() || name == "stream") {
+            return TapeStorage::kStream;
+        }
+        if (name == "mmap") {
+            return TapeStorage::kMmap;
+        }
+        if (name == "memory") {
+            return TapeStorage::kMemory;
+        }
+        throw std::invalid_argument("Unknown tape storage: " + std::string(name));
+    }
+
+    std::unique_ptr<TapeDevice> MakeTapeDevice(const std::filesystem::path &path,
+                                               TapeFormat format,
+                                               TapeStorage storage) {
+        switch (storage) {
+            case TapeStorage::kStream:
+                return std::make_unique<StreamDevice>(path, format);
+            case TapeStorage::kMmap:
+                if (format != TapeFormat::kBinary || std::endian::native != std::endian::little) {
+                    throw std::invalid_argument("Only binary tapes can be memory-mapped on a little-endian host");
+                }
+                return std::make_unique<MmapDevice>(path);
+            case TapeStorage::kMemory:
+                return std::make_unique<MemoryDevice>();
+        }
+        throw std::invalid_argument("Unknown tape storage");
+    }
+} // namespace tape_structure
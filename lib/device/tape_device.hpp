@@ -0,0 +1,142 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <span>
+
+#include "../chunk/chunk.hpp"
+#include "../format/tape_format.hpp"
+
+namespace tape_structure {
+    using TapeSize = ChunksCount;
+
+    /**
+     * Way to store the tape.
+     */
+    enum class TapeStorage {
+        /**
+         * Chunks are read from and written to a file stream.
+         */
+        kStream,
+        /**
+         * The file is mapped into memory and chunks are windows into the mapping.
+         * It is only available for tapes in the binary format.
+         */
+        kMmap,
+        /**
+         * The tape is kept in RAM and is not written to disk at all.
+         */
+        kMemory
+    };
+
+    /**
+     * Storage under the tape.
+     * The tape is divided into chunks of the same size (except the last one),
+     * and the device reads and writes them by their numbers.
+     */
+    class TapeDevice {
+    public:
+        virtual ~TapeDevice() = default;
+
+        /**
+         * Open the existing tape. A missing tape is created.
+         *
+         * @param size number of elements of the tape
+         * @param max_chunk_size size of all chunks except the last one
+         */
+        virtual void Open(TapeSize size, ChunkSize max_chunk_size) = 0;
+        /**
+         * Create an empty tape, the previous content is discarded.
+         *
+         * @param size number of elements of the tape
+         * @param max_chunk_size size of all chunks except the last one
+         */
+        virtual void Create(TapeSize size, ChunkSize max_chunk_size) = 0;
+        /**
+         * Checking that the tape is open.
+         *
+         * @return true if the tape is open else false
+         */
+        [[nodiscard]] virtual bool IsOpen() const = 0;
+        /**
+         * Cut the open tape, the numbers after the first `size` ones are discarded.
+         *
+         * @param size new number of elements of the tape, it is not greater than the current one
+         */
+        virtual void Truncate(TapeSize size) = 0;
+
+        /**
+         * Read the chunk.
+         * Numbers beyond the end of the stored data are read as zeros.
+         *
+         * @param chunk_number number of the chunk
+         * @param numbers where the numbers are read to, its size is the size of the chunk
+         */
+        virtual void ReadChunk(ChunksCount chunk_number, std::span<NumberType> numbers) = 0;
+        /**
+         * Write the chunk.
+         *
+         * @param chunk_number number of the chunk
+         * @param numbers numbers of the chunk
+         */
+        virtual void WriteChunk(ChunksCount chunk_number, std::span<const NumberType> numbers) = 0;
+        /**
+         * Get the numbers of the chunk right in the device memory, if the device allows it.
+         * Changes of the numbers are changes of the tape.
+         *
+         * @param chunk_number number of the chunk
+         * @return pointer to the first number of the chunk or nullptr
+         */
+        virtual NumberType *MapChunk(ChunksCount chunk_number);
+
+        /**
+         * Write buffered changes to the storage.
+         */
+        virtual void Flush();
+        /**
+         * Hint that the tape will be passed sequentially.
+         */
+        virtual void AdviseSequential();
+
+        /**
+         * Create a device over the same storage. It is not open.
+         *
+         * @return new device
+         */
+        [[nodiscard]] virtual std::unique_ptr<TapeDevice> Share() const = 0;
+        /**
+         * Get the format of the stored tape.
+         *
+         * @return format of the tape
+         */
+        [[nodiscard]] virtual TapeFormat GetFormat() const = 0;
+        /**
+         * Get the way the tape is stored.
+         *
+         * @return storage of the tape
+         */
+        [[nodiscard]] virtual TapeStorage GetStorage() const = 0;
+    };
+
+    /**
+     * Get the storage by its name in the config ("stream", "mmap" or "memory").
+     * An empty name means the stream storage.
+     *
+     * @param name name of the storage
+     * @return storage
+     */
+    TapeStorage ParseTapeStorage(std::string_view name);
+
+    /**
+     * Create a device for the tape.
+     * Throws std::invalid_argument if the storage does not support the format.
+     *
+     * @param path path to the tape file (it is not used by the in-memory storage)
+     * @param format format of the tape file
+     * @param storage way to store the tape
+     * @return new device, it is not open
+     */
+    std::unique_ptr<TapeDevice> MakeTapeDevice(const std::filesystem::path &path,
+                                               TapeFormat format,
+                                               TapeStorage storage);
+} // namespace tape_structure
@@ -0,0 +1,167 @@
+#include "tape_format.hpp"
+
+#include <cctype>
+#include <stdexcept>
+#include <string>
+
+namespace tape_structure {
+    namespace {
+        template <typename T>
+        void WriteLittleEndian(std::ostream &to, T value) {
+            if constexpr (std::endian::native == std::endian::big) {
+                value = std::byteswap(value);
+            }
+            to.write(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        template <typename T>
+        T ReadLittleEndian(std::istream &from) {
+            T value{};
+            from.read(reinterpret_cast<char *>(&value), sizeof(T));
+            if constexpr (std::endian::native == std::endian::big) {
+                value = std::byteswap(value);
+            }
+            return value;
+        }
+
+        void WriteHeaderWithMagic(std::ostream &to, const BinaryHeader &header, const std::array<char, 4> &magic) {
+            to.write(magic.data(), magic.size());
+            WriteLittleEndian(to, header.element_width_);
+            WriteLittleEndian(to, header.size_);
+        }
+
+        BinaryHeader ReadHeaderWithMagic(std::istream &from, const std::array<char, 4> &magic, const char *error) {
+            std::array<char, 4> read_magic{};
+            from.read(read_magic.data(), read_magic.size());
+            BinaryHeader header;
+            header.element_width_ = ReadLittleEndian<uint32_t>(from);
+            header.size_ = ReadLittleEndian<uint64_t>(from);
+
+            if (!from || read_magic != magic) {
+                throw std::runtime_error(error);
+            }
+            return header;
+        }
+    } // namespace
+
+    TapeFormat ParseTapeFormat(std::string_view name) {
+        if (name.empty() || name == "text") {
+            return TapeFormat::kText;
+        }
+        if (name == "binary") {
+            return TapeFormat::kBinary;
+        }
+        if (name == "compressed") {
+            return TapeFormat::kCompressed;
+        }
+        throw std::invalid_argument("Unknown tape format: " + std::string(name));
+    }
+
+    void WriteTapeHeader(std::ostream &to, TapeFormat format, const BinaryHeader &header) {
+        if (format == TapeFormat::kCompressed) {
+            compressed_format::WriteHeader(to, header);
+        } else {
+            binary_format::WriteHeader(to, header);
+        }
+    }
+
+    BinaryHeader ReadTapeHeader(std::istream &from, TapeFormat format) {
+        return format == TapeFormat::kCompressed ? compressed_format::ReadHeader(from)
+                                                 : binary_format::ReadHeader(from);
+    }
+
+    namespace binary_format {
+        void WriteHeader(std::ostream &to, const BinaryHeader &header) {
+            WriteHeaderWithMagic(to, header, kMagic);
+        }
+
+        BinaryHeader ReadHeader(std::istream &from) {
+            return ReadHeaderWithMagic(from, kMagic, "Tape file is not in the binary format");
+        }
+    } // namespace binary_format
+
+    namespace compressed_format {
+        void WriteHeader(std::ostream &to, const BinaryHeader &header) {
+            WriteHeaderWithMagic(to, header, kMagic);
+        }
+
+        BinaryHeader ReadHeader(std::istream &from) {
+            return ReadHeaderWithMagic(from, kMagic, "Tape file is not in the compressed format");
+        }
+
+        BlockHeader ReadBlockHeader(std::istream &from) {
+            BlockHeader header;
+            header.count_ = ReadLittleEndian<uint32_t>(from);
+            header.size_ = ReadLittleEndian<uint32_t>(from);
+            if (!from) {
+                from.clear();
+                return {};
+            }
+            return header;
+        }
+    } // namespace compressed_format
+
+    namespace text_format {
+        TextReader::TextReader(std::istream &from) : from_(from),
+                                                     begin_(from.tellg()) {}
+
+        void TextReader::Seek(std::streamoff offset) {
+            if (offset >= begin_ && offset <= begin_ + static_cast<std::streamoff>(end_)) {
+                pos_ = offset - begin_;
+                return;
+            }
+            Reset();
+            begin_ = offset;
+        }
+
+        void TextReader::Reset() {
+            begin_ += static_cast<std::streamoff>(pos_);
+            pos_ = 0;
+            end_ = 0;
+            eof_ = false;
+        }
+
+        void TextReader::SetBlockSize(size_t block_size) {
+            Reset();
+            block_size_ = std::max(block_size, kMinBlockSize);
+            buffer_ = {};
+        }
+
+        std::streamoff TextReader::Tell() const {
+            return begin_ + static_cast<std::streamoff>(pos_);
+        }
+
+        void TextReader::SkipSpaces() {
+            do {
+                while (pos_ < end_ && std::isspace(static_cast<unsigned char>(buffer_[pos_]))) {
+                    pos_++;
+                }
+            } while (pos_ == end_ && Fill());
+        }
+
+        bool TextReader::Fill() {
+            if (eof_) {
+                return false;
+            }
+            if (buffer_.empty()) {
+                buffer_.resize(block_size_);
+            }
+            std::memmove(buffer_.data(), buffer_.data() + pos_, end_ - pos_);
+            begin_ += static_cast<std::streamoff>(pos_);
+            end_ -= pos_;
+            pos_ = 0;
+            if (end_ == buffer_.size()) {
+                buffer_.resize(2 * buffer_.size());
+            }
+
+            from_.clear();
+            from_.seekg(begin_ + static_cast<std::streamoff>(end_));
+            from_.read(buffer_.data() + end_, static_cast<std::streamsize>(buffer_.size() - end_));
+            auto read = static_cast<size_t>(from_.gcount());
+            from_.clear();
+            end_ += read;
+            eof_ = end_ < buffer_.size();
+            return read != 0;
+        }
+    } // namespace text_format
+} // namespace tape_structure
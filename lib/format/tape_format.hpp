@@ -0,0 +1,507 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace tape_structure {
+    /**
+     * Format of the file in which the tape is stored.
+     */
+    enum class TapeFormat {
+        /**
+         * Decimal numbers separated by spaces.
+         * It is used to import and export tapes.
+         */
+        kText,
+        /**
+         * Header (BinaryHeader) followed by fixed-width little-endian numbers.
+         * The offset of any element is known in advance.
+         */
+        kBinary,
+        /**
+         * Header (BinaryHeader with its own magic) followed by blocks of numbers.
+         * Every block has a header (count of numbers, size of the block in bytes) and the differences
+         * of the neighbouring numbers as zigzag varints, so a sorted run takes 1-3 bytes per number.
+         * It is meant for the temporary tapes.
+         */
+        kCompressed
+    };
+
+    /**
+     * Header of the tape file in the binary format.
+     */
+    struct BinaryHeader {
+        /**
+         * Size of one element of the tape in bytes.
+         */
+        uint32_t element_width_{};
+        /**
+         * Number of elements of the tape.
+         */
+        uint64_t size_{};
+    };
+
+    /**
+     * Get the format by its name in the config ("text", "binary" or "compressed").
+     * An empty name means the text format.
+     *
+     * @param name name of the format
+     * @return format
+     */
+    TapeFormat ParseTapeFormat(std::string_view name);
+
+    /**
+     * Write the header to the beginning of the binary or compressed tape.
+     *
+     * @param to stream positioned at the beginning of the tape
+     * @param format format of the tape, it is not text
+     * @param header header to write
+     */
+    void WriteTapeHeader(std::ostream &to, TapeFormat format, const BinaryHeader &header);
+    /**
+     * Read and check the header of the binary or compressed tape.
+     * Throws std::runtime_error if the stream does not contain a tape of this format.
+     *
+     * @param from stream positioned at the beginning of the tape
+     * @param format format of the tape, it is not text
+     * @return header of the tape
+     */
+    BinaryHeader ReadTapeHeader(std::istream &from, TapeFormat format);
+
+    namespace binary_format {
+        constexpr std::array<char, 4> kMagic = {'T', 'A', 'P', 'E'};
+        constexpr std::streamoff kHeaderSize = 16;
+
+        /**
+         * Write the header to the beginning of the binary tape.
+         *
+         * @param to stream positioned at the beginning of the tape
+         * @param header header to write
+         */
+        void WriteHeader(std::ostream &to, const BinaryHeader &header);
+        /**
+         * Read and check the header of the binary tape.
+         * Throws std::runtime_error if the stream does not contain a binary tape.
+         *
+         * @param from stream positioned at the beginning of the tape
+         * @return header of the tape
+         */
+        BinaryHeader ReadHeader(std::istream &from);
+
+        /**
+         * Get the offset of the element in the binary tape file.
+         *
+         * @param index index of the element
+         * @param element_width size of one element in bytes
+         * @return offset in bytes from the beginning of the file
+         */
+        constexpr std::streamoff OffsetOf(uint64_t index, uint32_t element_width) {
+            return kHeaderSize + static_cast<std::streamoff>(index * element_width);
+        }
+
+        /**
+         * Write numbers as fixed-width little-endian records.
+         *
+         * @param to stream where the numbers are written
+         * @param numbers pointer to the first number
+         * @param count count of numbers
+         */
+        template <typename T>
+        void WriteNumbers(std::ostream &to, const T *numbers, size_t count) {
+            if constexpr (std::endian::native == std::endian::little) {
+                to.write(reinterpret_cast<const char *>(numbers), static_cast<std::streamsize>(count * sizeof(T)));
+            } else {
+                for (size_t i = 0; i < count; i++) {
+                    T number = std::byteswap(numbers[i]);
+                    to.write(reinterpret_cast<const char *>(&number), sizeof(T));
+                }
+            }
+        }
+
+        /**
+         * Read fixed-width little-endian records.
+         * If the stream ends earlier, the rest of the numbers are filled with zeros.
+         *
+         * @param from stream from where the numbers are read
+         * @param numbers pointer to the first number
+         * @param count count of numbers
+         * @return count of numbers actually read
+         */
+        template <typename T>
+        size_t ReadNumbers(std::istream &from, T *numbers, size_t count) {
+            from.read(reinterpret_cast<char *>(numbers), static_cast<std::streamsize>(count * sizeof(T)));
+            size_t read = static_cast<size_t>(from.gcount()) / sizeof(T);
+            std::memset(reinterpret_cast<char *>(numbers + read), 0, (count - read) * sizeof(T));
+            if constexpr (std::endian::native == std::endian::big) {
+                for (size_t i = 0; i < read; i++) {
+                    numbers[i] = std::byteswap(numbers[i]);
+                }
+            }
+            return read;
+        }
+    } // namespace binary_format
+
+    namespace text_format {
+        /**
+         * Reader of the decimal numbers of the text tape.
+         * The file is read by big raw blocks and the numbers are parsed by std::from_chars,
+         * so no formatted extraction of the stream (with its locale and sentries) is done for every number.
+         * The block stays in the reader, so the next numbers are parsed without reading the stream
+         * until the reader is moved out of the block or reset.
+         */
+        class TextReader {
+        public:
+            /**
+             * Create the reader of the stream. It reads from the offset the stream is positioned at.
+             *
+             * @param from stream with the text tape
+             */
+            explicit TextReader(std::istream &from);
+
+            /**
+             * Move the reader to the offset in the stream.
+             * The block is kept if the offset is inside it.
+             *
+             * @param offset offset in bytes from the beginning of the stream
+             */
+            void Seek(std::streamoff offset);
+            /**
+             * Forget the block, it should be called when the stream is written.
+             */
+            void Reset();
+            /**
+             * Change the size of the blocks the stream is read by. The block is forgotten and its memory is freed,
+             * the memory of the next block is taken when it is read.
+             *
+             * @param block_size size of the blocks, at least kMinBlockSize
+             */
+            void SetBlockSize(size_t block_size);
+            /**
+             * Get the offset of the next byte to be parsed.
+             *
+             * @return offset in bytes from the beginning of the stream
+             */
+            [[nodiscard]] std::streamoff Tell() const;
+            /**
+             * Skip the whitespace characters before the next number.
+             */
+            void SkipSpaces();
+
+            /**
+             * Read the next number like the formatted extraction of the stream does:
+             * the leading whitespace characters are skipped and the sign is optional.
+             *
+             * @param number where the number is read to
+             * @return true if the number is read, false at the end of the stream or if it is not a number
+             */
+            template <typename T>
+            bool ReadNumber(T &number) {
+                SkipSpaces();
+                if (end_ - pos_ < kMaxNumberLength) {
+                    Fill();
+                }
+                while (true) {
+                    const char *first = buffer_.data() + pos_;
+                    const char *last = buffer_.data() + end_;
+                    if (first != last && *first == '+') {
+                        first++;
+                    }
+                    auto [ptr, error] = std::from_chars(first, last, number);
+                    if (ptr == last && Fill()) {
+                        // The number may continue in the next block.
+                        continue;
+                    }
+                    if (error != std::errc{}) {
+                        return false;
+                    }
+                    pos_ = ptr - buffer_.data();
+                    return true;
+                }
+            }
+
+            /**
+             * Read the numbers.
+             * If the stream ends earlier, the rest of the numbers are filled with zeros.
+             *
+             * @param numbers pointer to the first number
+             * @param count count of numbers
+             * @return count of numbers actually read
+             */
+            template <typename T>
+            size_t ReadNumbers(T *numbers, size_t count) {
+                size_t read = 0;
+                while (read < count && ReadNumber(numbers[read])) {
+                    read++;
+                }
+                std::fill(numbers + read, numbers + count, T{});
+                return read;
+            }
+
+            /**
+             * Size of the blocks the stream is read by by default.
+             */
+            static constexpr size_t kBlockSize = 1 << 16;
+            /**
+             * Count of bytes which are enough for any number not padded with zeros.
+             * The reader reads the next block if fewer bytes are left, so the number is parsed at once.
+             */
+            static constexpr size_t kMaxNumberLength = 32;
+            /**
+             * Minimum size of the blocks, a number and the rest of the previous one fit in the block.
+             */
+            static constexpr size_t kMinBlockSize = 2 * kMaxNumberLength;
+
+        private:
+            /**
+             * Move the unparsed bytes to the beginning of the buffer and read the next block after them.
+             *
+             * @return true if something is read
+             */
+            bool Fill();
+
+            /**
+             * Stream with the text tape.
+             */
+            std::istream &from_;
+            /**
+             * Size of the blocks the stream is read by.
+             */
+            size_t block_size_ = kBlockSize;
+            /**
+             * Bytes of the stream from the offset begin_. It is empty until the first block is read.
+             */
+            std::vector<char> buffer_;
+            /**
+             * Offset of the first byte of the buffer in the stream.
+             */
+            std::streamoff begin_{};
+            /**
+             * Position of the next byte to be parsed in the buffer.
+             */
+            size_t pos_{};
+            /**
+             * Count of the bytes in the buffer.
+             */
+            size_t end_{};
+            /**
+             * Whether the end of the stream is in the buffer.
+             */
+            bool eof_ = false;
+        };
+
+        /**
+         * Count of bytes the number takes in the text format at most, with the space after it:
+         * the sign and the digits, and the point and the exponent of the floating-point numbers.
+         */
+        template <typename T>
+        constexpr size_t kMaxTextLength = std::is_floating_point_v<T> ? std::numeric_limits<T>::max_digits10 + 8
+                                                                      : std::numeric_limits<T>::digits10 + 3;
+
+        /**
+         * Append the numbers in the text format (every number is followed by a space) to the string.
+         * The numbers are printed by std::to_chars, so the string may be reused as the output buffer.
+         * Floating-point numbers are printed in the shortest form which is read back to the same number.
+         *
+         * @param to string where the text is appended
+         * @param numbers pointer to the first number
+         * @param count count of numbers
+         */
+        template <typename T>
+        void AppendNumbers(std::string &to, const T *numbers, size_t count) {
+            to.resize_and_overwrite(to.size() + count * kMaxTextLength<T>, [&](char *text, size_t size) {
+                char *out = text + to.size();
+                for (size_t i = 0; i < count; i++) {
+                    out = std::to_chars(out, text + size, numbers[i]).ptr;
+                    *out++ = ' ';
+                }
+                return static_cast<size_t>(out - text);
+            });
+        }
+    } // namespace text_format
+
+    namespace compressed_format {
+        constexpr std::array<char, 4> kMagic = {'T', 'A', 'P', 'Z'};
+        constexpr std::streamoff kHeaderSize = binary_format::kHeaderSize;
+        /**
+         * Count of numbers in every block but the last one.
+         * It is the minimum size of the merge chunks, so the chunks of the temporary tapes are whole blocks.
+         */
+        constexpr size_t kBlockLength = 1024;
+        constexpr std::streamoff kBlockHeaderSize = 8;
+        /**
+         * Maximum size of a varint of 64 bits.
+         */
+        constexpr size_t kMaxVarintSize = 10;
+        /**
+         * Maximum size of the varint of the difference of two numbers of the type:
+         * the difference of 32-bit numbers takes 33 bits, 34 bits zigzag-encoded.
+         */
+        template <typename T>
+        constexpr size_t kMaxDifferenceSize = sizeof(T) == sizeof(int64_t) ? kMaxVarintSize : 5;
+
+        /**
+         * Integer of the size of the number which the differences are taken of.
+         * The floating-point numbers are taken by their bits.
+         */
+        template <typename T>
+        using Bits = std::conditional_t<sizeof(T) == sizeof(int64_t), int64_t, int32_t>;
+
+        template <typename T>
+        int64_t ToBits(T number) {
+            if constexpr (std::is_floating_point_v<T>) {
+                return std::bit_cast<Bits<T>>(number);
+            } else {
+                return static_cast<int64_t>(number);
+            }
+        }
+
+        template <typename T>
+        T FromBits(int64_t bits) {
+            if constexpr (std::is_floating_point_v<T>) {
+                return std::bit_cast<T>(static_cast<Bits<T>>(bits));
+            } else {
+                return static_cast<T>(bits);
+            }
+        }
+
+        /**
+         * Header of the block of the compressed tape.
+         */
+        struct BlockHeader {
+            /**
+             * Count of numbers of the block, 0 if there is no block.
+             */
+            uint32_t count_{};
+            /**
+             * Size of the encoded numbers in bytes (without the header).
+             */
+            uint32_t size_{};
+        };
+
+        /**
+         * Write the header to the beginning of the compressed tape.
+         *
+         * @param to stream positioned at the beginning of the tape
+         * @param header header to write
+         */
+        void WriteHeader(std::ostream &to, const BinaryHeader &header);
+        /**
+         * Read and check the header of the compressed tape.
+         * Throws std::runtime_error if the stream does not contain a compressed tape.
+         *
+         * @param from stream positioned at the beginning of the tape
+         * @return header of the tape
+         */
+        BinaryHeader ReadHeader(std::istream &from);
+        /**
+         * Read the header of the next block.
+         *
+         * @param from stream positioned at the block
+         * @return header of the block, it is empty at the end of the stream
+         */
+        BlockHeader ReadBlockHeader(std::istream &from);
+
+        /**
+         * Append the block of numbers with its header to the string.
+         * Every number is stored as the difference with the previous one (the first one with zero),
+         * zigzag-encoded so that small negative differences are small too, by 7 bits per byte.
+         * The differences of the floating-point numbers are taken of their bits.
+         *
+         * @param to string where the block is appended
+         * @param numbers pointer to the first number
+         * @param count count of numbers, at most kBlockLength
+         */
+        template <typename T>
+        void AppendBlock(std::string &to, const T *numbers, size_t count) {
+            size_t begin = to.size();
+            to.resize_and_overwrite(begin + kBlockHeaderSize + count * kMaxDifferenceSize<T>, [&](char *text, size_t) {
+                char *out = text + begin + kBlockHeaderSize;
+                uint64_t previous = 0;
+                for (size_t i = 0; i < count; i++) {
+                    auto number = static_cast<uint64_t>(ToBits(numbers[i]));
+                    uint64_t delta = number - previous;
+                    uint64_t zigzag = (delta << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(delta) >> 63);
+                    for (; zigzag >= 0x80; zigzag >>= 7) {
+                        *out++ = static_cast<char>(zigzag | 0x80);
+                    }
+                    *out++ = static_cast<char>(zigzag);
+                    previous = number;
+                }
+
+                std::array<uint32_t, 2> header = {static_cast<uint32_t>(count),
+                                                  static_cast<uint32_t>(out - text - begin - kBlockHeaderSize)};
+                if constexpr (std::endian::native == std::endian::big) {
+                    header = {std::byteswap(header[0]), std::byteswap(header[1])};
+                }
+                std::memcpy(text + begin, header.data(), kBlockHeaderSize);
+                return static_cast<size_t>(out - text);
+            });
+        }
+
+        /**
+         * Decode the numbers of the block.
+         * Throws std::runtime_error if the block is corrupted.
+         *
+         * @param encoded encoded numbers of the block (without the header)
+         * @param numbers where the numbers are decoded to
+         * @param count count of numbers of the block
+         */
+        template <typename T>
+        void DecodeBlock(std::string_view encoded, T *numbers, size_t count) {
+            const char *in = encoded.data();
+            const char *end = in + encoded.size();
+            uint64_t previous = 0;
+            for (size_t i = 0; i < count; i++) {
+                uint64_t zigzag = 0;
+                for (int shift = 0;; shift += 7) {
+                    if (in == end || shift >= 64) {
+                        throw std::runtime_error("Block of the compressed tape is corrupted");
+                    }
+                    auto byte = static_cast<uint8_t>(*in++);
+                    zigzag |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                    if (byte < 0x80) {
+                        break;
+                    }
+                }
+                previous += (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+                numbers[i] = FromBits<T>(static_cast<int64_t>(previous));
+            }
+        }
+
+        /**
+         * Read and decode the next block.
+         * Throws std::runtime_error if the block is corrupted.
+         *
+         * @param from stream positioned at the block
+         * @param encoded buffer for the encoded numbers
+         * @param numbers where the numbers are decoded to, there is room for kBlockLength numbers
+         * @return header of the block, it is empty at the end of the stream
+         */
+        template <typename T>
+        BlockHeader ReadBlock(std::istream &from, std::string &encoded, T *numbers) {
+            BlockHeader header = ReadBlockHeader(from);
+            if (header.count_ > kBlockLength) {
+                throw std::runtime_error("Block of the compressed tape is corrupted");
+            }
+            encoded.resize(header.size_);
+            from.read(encoded.data(), header.size_);
+            if (static_cast<size_t>(from.gcount()) != header.size_) {
+                throw std::runtime_error("Block of the compressed tape is corrupted");
+            }
+            DecodeBlock(encoded, numbers, header.count_);
+            return header;
+        }
+    } // namespace compressed_format
+} // namespace tape_structure
@@ -0,0 +1,100 @@
+#include "mapped_file.hpp"
+
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tape_structure {
+    MappedFile::MappedFile(MappedFile &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+        if (&other == this) {
+            return *this;
+        }
+
+        Close();
+        fd_ = std::exchange(other.fd_, -1);
+        data_ = std::exchange(other.data_, nullptr);
+        length_ = std::exchange(other.length_, 0);
+
+        return *this;
+    }
+
+    MappedFile::~MappedFile() {
+        Close();
+    }
+
+    void MappedFile::Open(const std::filesystem::path &path, size_t length) {
+        Close();
+
+#ifdef __linux__
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd_ == -1) {
+            throw std::system_error(errno, std::generic_category(), "Could not open tape file " + path.string());
+        }
+
+        struct stat file_stat {};
+        if (::fstat(fd_, &file_stat) == -1 ||
+            (static_cast<size_t>(file_stat.st_size) < length && ::ftruncate(fd_, static_cast<off_t>(length)) == -1)) {
+            int error = errno;
+            Close();
+            throw std::system_error(error, std::generic_category(), "Could not resize tape file " + path.string());
+        }
+
+        void *data = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (data == MAP_FAILED) {
+            int error = errno;
+            Close();
+            throw std::system_error(error, std::generic_category(), "Could not map tape file " + path.string());
+        }
+        data_ = static_cast<char *>(data);
+        length_ = length;
+#else
+        throw std::system_error(std::make_error_code(std::errc::function_not_supported),
+                                "Memory-mapped tapes are supported only on Linux, could not map " + path.string());
+#endif
+    }
+
+    void MappedFile::Close() {
+#ifdef __linux__
+        if (data_ != nullptr) {
+            ::munmap(data_, length_);
+            data_ = nullptr;
+            length_ = 0;
+        }
+        if (fd_ != -1) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+#endif
+    }
+
+    void MappedFile::AdviseSequential() const {
+#ifdef __linux__
+        if (data_ != nullptr) {
+            ::madvise(data_, length_, MADV_SEQUENTIAL);
+        }
+#endif
+    }
+
+    bool MappedFile::IsOpen() const {
+        return data_ != nullptr;
+    }
+
+    char *MappedFile::GetData() const {
+        return data_;
+    }
+
+    size_t MappedFile::GetLength() const {
+        return length_;
+    }
+} // namespace tape_structure
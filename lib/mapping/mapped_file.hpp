@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace tape_structure {
+    /**
+     * File mapped into memory (mmap) for reading and writing.
+     * Changes of the mapped memory are visible to everyone who reads the file.
+     * It is supported only on Linux, elsewhere the file can not be opened.
+     */
+    class MappedFile {
+    public:
+        MappedFile() = default;
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        MappedFile(MappedFile &&) noexcept;
+        MappedFile &operator=(MappedFile &&) noexcept;
+
+        ~MappedFile();
+
+        /**
+         * Map the file into memory.
+         * The file is extended with zeros if it is shorter than the length.
+         * Throws std::system_error if the file cannot be mapped (always if it is not Linux).
+         *
+         * @param path path to the file
+         * @param length number of bytes to map
+         */
+        void Open(const std::filesystem::path &path, size_t length);
+        /**
+         * Unmap the file.
+         */
+        void Close();
+
+        /**
+         * Hint the kernel that the mapping will be accessed sequentially,
+         * so it reads ahead and frees passed pages earlier.
+         */
+        void AdviseSequential() const;
+
+        /**
+         * Checking that the file is mapped.
+         *
+         * @return true if the file is mapped else false
+         */
+        [[nodiscard]] bool IsOpen() const;
+        /**
+         * Get the beginning of the mapped memory.
+         *
+         * @return pointer to the first mapped byte
+         */
+        [[nodiscard]] char *GetData() const;
+        /**
+         * Get the length of the mapped memory.
+         *
+         * @return number of mapped bytes
+         */
+        [[nodiscard]] size_t GetLength() const;
+
+    private:
+        /**
+         * Descriptor of the mapped file.
+         */
+        int fd_ = -1;
+        /**
+         * Beginning of the mapped memory.
+         */
+        char *data_ = nullptr;
+        /**
+         * Number of mapped bytes.
+         */
+        size_t length_ = 0;
+    };
+} // namespace tape_structure
@@ -0,0 +1,63 @@
+#include "loser_tree.hpp"
+
+#include <utility>
+
+namespace tape_structure {
+    LoserTree::LoserTree(size_t ways) : numbers_(ways), exhausted_(ways, true), tree_(ways) {}
+
+    void LoserTree::SetNumber(size_t way, std::optional<NumberType> number) {
+        exhausted_[way] = !number.has_value();
+        numbers_[way] = number.value_or(0);
+    }
+
+    void LoserTree::Build() {
+        tree_[0] = Play(1);
+    }
+
+    bool LoserTree::IsEmpty() const {
+        return exhausted_[tree_[0]];
+    }
+
+    size_t LoserTree::GetWinner() const {
+        return tree_[0];
+    }
+
+    NumberType LoserTree::GetWinnerNumber() const {
+        return numbers_[tree_[0]];
+    }
+
+    void LoserTree::ReplaceWinner(std::optional<NumberType> number) {
+        size_t winner = tree_[0];
+        SetNumber(winner, number);
+        for (size_t node = (winner + tree_.size()) / 2; node > 0; node /= 2) {
+            if (IsBefore(tree_[node], winner)) {
+                std::swap(tree_[node], winner);
+            }
+        }
+        tree_[0] = winner;
+    }
+
+    size_t LoserTree::Play(size_t node) {
+        if (node >= tree_.size()) {
+            return node - tree_.size();
+        }
+        size_t left = Play(2 * node);
+        size_t right = Play(2 * node + 1);
+        if (IsBefore(left, right)) {
+            tree_[node] = right;
+            return left;
+        }
+        tree_[node] = left;
+        return right;
+    }
+
+    bool LoserTree::IsBefore(size_t first, size_t second) const {
+        if (exhausted_[first] != exhausted_[second]) {
+            return exhausted_[second];
+        }
+        if (numbers_[first] != numbers_[second]) {
+            return numbers_[first] < numbers_[second];
+        }
+        return first < second;
+    }
+} // namespace tape_structure
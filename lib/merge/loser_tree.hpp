@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "../chunk/chunk.hpp"
+
+namespace tape_structure {
+    /**
+     * Tournament tree of losers for merging k sorted sequences.
+     * Every inner node keeps the sequence which lost the match in it, the winner (the sequence
+     * with the minimum current number) is kept separately, so replacing the number of the winner
+     * takes one pass from its leaf to the root, log2(k) comparisons.
+     * Equal numbers are taken from the sequence with the smaller index first.
+     */
+    class LoserTree {
+    public:
+        LoserTree() = default;
+        explicit LoserTree(size_t ways);
+
+        /**
+         * Set the first number of the sequence before the tree is built.
+         *
+         * @param way index of the sequence
+         * @param number first number or std::nullopt if the sequence is empty
+         */
+        void SetNumber(size_t way, std::optional<NumberType> number);
+        /**
+         * Play all the matches after the first numbers are set.
+         */
+        void Build();
+
+        /**
+         * Checking that all the sequences are exhausted.
+         *
+         * @return true if there are no numbers left else false
+         */
+        [[nodiscard]] bool IsEmpty() const;
+        /**
+         * Get the index of the sequence with the minimum current number.
+         *
+         * @return index of the winner
+         */
+        [[nodiscard]] size_t GetWinner() const;
+        /**
+         * Get the minimum current number.
+         *
+         * @return number of the winner
+         */
+        [[nodiscard]] NumberType GetWinnerNumber() const;
+
+        /**
+         * Replace the number of the winner with the next number of its sequence and replay its matches.
+         *
+         * @param number next number or std::nullopt if the sequence is exhausted
+         */
+        void ReplaceWinner(std::optional<NumberType> number);
+
+    private:
+        /**
+         * Play the matches of the subtree.
+         *
+         * @param node root of the subtree
+         * @return winner of the subtree
+         */
+        size_t Play(size_t node);
+        /**
+         * Checking that the first sequence wins the second one.
+         *
+         * @return true if the current number of the first sequence goes first else false
+         */
+        [[nodiscard]] bool IsBefore(size_t first, size_t second) const;
+
+        /**
+         * Current numbers of the sequences.
+         */
+        std::vector<NumberType> numbers_;
+        /**
+         * Flags of the exhausted sequences.
+         */
+        std::vector<bool> exhausted_;
+        /**
+         * Losers in the inner nodes 1..k-1 (the children of node i are 2i and 2i+1,
+         * leaf of the sequence j is k+j), the winner is in node 0.
+         */
+        std::vector<size_t> tree_;
+    };
+} // namespace tape_structure
@@ -0,0 +1,132 @@
+#include "merge_kernel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TAPE_STRUCTURE_MERGE_AVX2
+#endif
+
+namespace tape_structure {
+    namespace {
+        template <typename T>
+        void MergeScalar(std::span<const T> first, std::span<const T> second, T *out) {
+            size_t i = 0;
+            size_t j = 0;
+            while (i < first.size() && j < second.size()) {
+                bool take_first = first[i] <= second[j];
+                *out++ = take_first ? first[i] : second[j];
+                i += take_first;
+                j += !take_first;
+            }
+            out = std::copy(first.begin() + i, first.end(), out);
+            std::copy(second.begin() + j, second.end(), out);
+        }
+
+#ifdef TAPE_STRUCTURE_MERGE_AVX2
+        constexpr size_t kLanes = 8;
+
+        __attribute__((target("avx2"))) __m256i Load(const int32_t *from) {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(from));
+        }
+
+        /**
+         * Sort the bitonic sequence of 8 numbers.
+         */
+        __attribute__((target("avx2"))) __m256i SortBitonic(__m256i v) {
+            __m256i t = _mm256_permute2x128_si256(v, v, 0x01);
+            v = _mm256_blend_epi32(_mm256_min_epi32(v, t), _mm256_max_epi32(v, t), 0xF0);
+            t = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+            v = _mm256_blend_epi32(_mm256_min_epi32(v, t), _mm256_max_epi32(v, t), 0xCC);
+            t = _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+            return _mm256_blend_epi32(_mm256_min_epi32(v, t), _mm256_max_epi32(v, t), 0xAA);
+        }
+
+        /**
+         * Merge two sorted vectors by the bitonic network: low gets the 8 smallest numbers, high the 8 largest.
+         */
+        __attribute__((target("avx2"))) void MergeVectors(__m256i &low, __m256i &high) {
+            __m256i reversed = _mm256_permutevar8x32_epi32(high, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+            __m256i min = _mm256_min_epi32(low, reversed);
+            __m256i max = _mm256_max_epi32(low, reversed);
+            low = SortBitonic(min);
+            high = SortBitonic(max);
+        }
+
+        /**
+         * Merge the blocks 8 numbers at a time: the next 8 numbers are taken from the block whose next number
+         * is smaller and merged with the 8 largest numbers left from the previous step.
+         * The lanes are 32-bit signed integers, so it is not used by the builds of other numbers.
+         */
+        [[maybe_unused]] __attribute__((target("avx2"))) void MergeSortedAvx2(std::span<const int32_t> first,
+                                                                              std::span<const int32_t> second,
+                                                                              int32_t *out) {
+            if (first.size() < kLanes || second.size() < kLanes) {
+                MergeScalar(first, second, out);
+                return;
+            }
+
+            __m256i low = Load(first.data());
+            __m256i high = Load(second.data());
+            size_t i = kLanes;
+            size_t j = kLanes;
+            while (true) {
+                MergeVectors(low, high);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), low);
+                out += kLanes;
+
+                bool first_left = i + kLanes <= first.size();
+                bool second_left = j + kLanes <= second.size();
+                bool first_next = first_left && (j == second.size() || (second_left && first[i] <= second[j]));
+                bool second_next = second_left && (i == first.size() || (first_left && second[j] < first[i]));
+                if (first_next) {
+                    low = Load(first.data() + i);
+                    i += kLanes;
+                } else if (second_next) {
+                    low = Load(second.data() + j);
+                    j += kLanes;
+                } else {
+                    break;
+                }
+            }
+
+            // One of the blocks has less than 8 numbers left, they are merged with the rest of the vector first.
+            std::span<const int32_t> first_rest = first.subspan(i);
+            std::span<const int32_t> second_rest = second.subspan(j);
+            if (first_rest.size() >= kLanes) {
+                std::swap(first_rest, second_rest);
+            }
+            std::array<int32_t, kLanes> rest{};
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(rest.data()), high);
+            std::array<int32_t, 2 * kLanes> short_rest{};
+            MergeScalar<int32_t>(rest, first_rest, short_rest.data());
+            MergeScalar<int32_t>(std::span(short_rest).first(kLanes + first_rest.size()), second_rest, out);
+        }
+#endif
+
+        template <typename T>
+        void MergeFastest(std::span<const T> first, std::span<const T> second, T *out) {
+#ifdef TAPE_STRUCTURE_MERGE_AVX2
+            if constexpr (std::is_same_v<T, int32_t>) {
+                static const bool kHasAvx2 = __builtin_cpu_supports("avx2");
+                if (kHasAvx2) {
+                    MergeSortedAvx2(first, second, out);
+                    return;
+                }
+            }
+#endif
+            MergeScalar(first, second, out);
+        }
+    } // namespace
+
+    void MergeSorted(std::span<const NumberType> first, std::span<const NumberType> second, NumberType *out) {
+        MergeFastest(first, second, out);
+    }
+
+    void MergeSortedScalar(std::span<const NumberType> first, std::span<const NumberType> second, NumberType *out) {
+        MergeScalar(first, second, out);
+    }
+} // namespace tape_structure
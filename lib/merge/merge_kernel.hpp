@@ -0,0 +1,23 @@
+#pragma once
+
+#include <span>
+
+#include "../chunk/chunk.hpp"
+
+namespace tape_structure {
+    /**
+     * Merge two sorted blocks of numbers.
+     * The AVX2 kernel is used for 32-bit signed numbers if the processor supports it
+     * (it is checked once at runtime), otherwise the scalar one.
+     *
+     * @param first first sorted block
+     * @param second second sorted block
+     * @param out where the merged numbers are written, there is room for first.size() + second.size() numbers
+     */
+    void MergeSorted(std::span<const NumberType> first, std::span<const NumberType> second, NumberType *out);
+
+    /**
+     * Scalar kernel of MergeSorted. The choice of the block to take the number from is branchless.
+     */
+    void MergeSortedScalar(std::span<const NumberType> first, std::span<const NumberType> second, NumberType *out);
+} // namespace tape_structure
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <queue>
+
+namespace tape_structure {
+    /**
+     * Queue of a limited capacity shared by producer and consumer threads.
+     * Pushing into the full queue waits until there is room, popping from the empty queue waits
+     * until there is an element or the queue is closed.
+     */
+    template <typename T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+
+        /**
+         * Put the element at the end of the queue.
+         *
+         * @param element new element
+         * @return false if the queue is closed (the element is dropped) else true
+         */
+        bool Push(T element) {
+            std::unique_lock lock(mutex_);
+            not_full_.wait(lock, [this]() { return closed_ || elements_.size() < capacity_; });
+            if (closed_) {
+                return false;
+            }
+            elements_.push(std::move(element));
+            not_empty_.notify_one();
+            return true;
+        }
+
+        /**
+         * Take the element from the beginning of the queue.
+         *
+         * @return element or std::nullopt if the queue is closed and empty
+         */
+        std::optional<T> Pop() {
+            std::unique_lock lock(mutex_);
+            not_empty_.wait(lock, [this]() { return closed_ || !elements_.empty(); });
+            if (elements_.empty()) {
+                return std::nullopt;
+            }
+            T element = std::move(elements_.front());
+            elements_.pop();
+            not_full_.notify_one();
+            return element;
+        }
+
+        /**
+         * Close the queue: nothing can be pushed anymore, and the remaining elements can still be popped.
+         */
+        void Close() {
+            std::lock_guard lock(mutex_);
+            closed_ = true;
+            not_full_.notify_all();
+            not_empty_.notify_all();
+        }
+
+    private:
+        size_t capacity_;
+        std::queue<T> elements_;
+        bool closed_ = false;
+
+        std::mutex mutex_;
+        std::condition_variable not_full_;
+        std::condition_variable not_empty_;
+    };
+} // namespace tape_structure
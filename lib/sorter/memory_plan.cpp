@@ -0,0 +1,310 @@
+#include "memory_plan.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+#include "../chunk/chunk_pool.hpp"
+#include "../device/stream_device.hpp"
+#include "../sorting/run_sort.hpp"
+
+namespace tape_structure {
+    namespace {
+        /**
+         * Size of the item of the heap of replacement selection (number of the run and the number).
+         */
+        constexpr uint64_t kHeapItemSize = sizeof(std::pair<TapeSize, NumberType>);
+        /**
+         * Chunks of replacement selection besides the heap: the chunk of the input tape being read and its copy,
+         * the buffer of the run being filled, two buffers of the appended numbers and the chunk of the last flush.
+         */
+        constexpr TapeSize kReplacementSelectionBuffers = 6;
+    } // namespace
+
+    MemoryPlan::MemoryPlan(MemorySize memory,
+                           TapeSize size,
+                           const SortOptions &options,
+                           TapeFormat format_in,
+                           TapeFormat format_out) : memory_(memory),
+                                                    size_(size),
+                                                    options_(options),
+                                                    format_in_(format_in),
+                                                    format_out_(format_out) {
+        if (memory_ < CountLeastMemory()) {
+            throw std::invalid_argument("Memory is not enough for the buffers of the sorting");
+        }
+        split_chunk_size_ = FitChunkSize([this](ChunkSize chunk_size) { return CountSplitMemory(chunk_size); });
+        heap_capacity_ = 2 * static_cast<size_t>(split_chunk_size_);
+
+        merges_ = std::max<TapeSize>(options_.workers_, 1);
+        if (options_.merge_io_limit_ != 0 && options_.tmp_storage_ != TapeStorage::kMemory) {
+            merges_ = std::min(merges_, options_.merge_io_limit_);
+        }
+        ChunkSize min_chunk_size = std::min<ChunkSize>(kMinMergeChunkSize, std::max<TapeSize>(size_, 1));
+        while (merges_ > 1 && CountMergeMemory(2, merges_, min_chunk_size) > memory_) {
+            merges_--;
+        }
+    }
+
+    ChunkSize MemoryPlan::GetSplitChunkSize() const {
+        return split_chunk_size_;
+    }
+
+    size_t MemoryPlan::GetHeapCapacity() const {
+        return heap_capacity_;
+    }
+
+    TapeSize MemoryPlan::GetParallelMerges() const {
+        return merges_;
+    }
+
+    TapeSize MemoryPlan::CountMergeWays(TapeSize count_of_tapes) const {
+        ChunkSize min_chunk_size = std::min<ChunkSize>(kMinMergeChunkSize, std::max<TapeSize>(size_, 1));
+        auto fits = [&](TapeSize ways) {
+            return CountMergeMemory(ways, merges_, min_chunk_size) <= memory_ &&
+                   CountFinalMergeMemory(ways, min_chunk_size) <= memory_;
+        };
+
+        // The memory grows with the ways, the biggest count which fits is searched between 2 and count_of_tapes.
+        TapeSize ways = 2;
+        TapeSize too_many = std::max<TapeSize>(count_of_tapes, 2) + 1;
+        while (too_many - ways > 1) {
+            TapeSize middle = ways + (too_many - ways) / 2;
+            if (fits(middle)) {
+                ways = middle;
+            } else {
+                too_many = middle;
+            }
+        }
+        return ways;
+    }
+
+    ChunkSize MemoryPlan::CountMergeChunkSize(TapeSize ways, TapeSize merges) const {
+        ChunkSize size = FitChunkSize([this, ways, merges](ChunkSize chunk_size) {
+            return CountMergeMemory(ways, merges, chunk_size);
+        });
+        return std::max<ChunkSize>(size, 1);
+    }
+
+    ChunkSize MemoryPlan::CountFinalMergeChunkSize(TapeSize ways) const {
+        ChunkSize size = FitChunkSize([this, ways](ChunkSize chunk_size) {
+            return CountFinalMergeMemory(ways, chunk_size);
+        });
+        return std::max<ChunkSize>(size, 1);
+    }
+
+    uint64_t MemoryPlan::CountSplitPoolMemory() const {
+        // The scratch buffers of the sorting and the buffer of the run of replacement selection are vectors.
+        if (options_.polyphase_tapes_ != 0) {
+            return CountBuffersMemory(CountPolyphaseBuffers() - CountSortingThreads(), split_chunk_size_);
+        }
+        if (options_.split_strategy_ == SplitStrategy::kReplacementSelection) {
+            TapeSize buffers = kReplacementSelectionBuffers + (options_.read_ahead_ ? 1 : 0);
+            return CountBuffersMemory(buffers - 1, split_chunk_size_);
+        }
+        return CountBuffersMemory(CountSplitBuffers() - CountSortingThreads(), split_chunk_size_);
+    }
+
+    uint64_t MemoryPlan::CountMergePoolMemory(TapeSize ways, ChunkSize chunk_size, TapeSize merges) const {
+        return merges * CountBuffersMemory(CountMergeBuffers(ways), chunk_size);
+    }
+
+    uint64_t MemoryPlan::CountPeakMemory(TapeSize count_of_runs) const {
+        uint64_t peak = CountSplitMemory(split_chunk_size_);
+        if (options_.polyphase_tapes_ != 0) {
+            return peak;
+        }
+
+        TapeSize ways = CountMergeWays(count_of_runs);
+        if (count_of_runs > ways) {
+            peak = std::max(peak, CountMergeMemory(ways, merges_, CountMergeChunkSize(ways, merges_)));
+        }
+        for (TapeSize i = 2; i <= std::min(count_of_runs, ways); i++) {
+            peak = std::max(peak, CountFinalMergeMemory(i, CountFinalMergeChunkSize(i)));
+        }
+        return peak;
+    }
+
+    uint64_t MemoryPlan::CountLeastMemory(TapeSize size,
+                                          const SortOptions &options,
+                                          TapeFormat format_in,
+                                          TapeFormat format_out) {
+        MemoryPlan plan;
+        plan.size_ = size;
+        plan.options_ = options;
+        plan.format_in_ = format_in;
+        plan.format_out_ = format_out;
+        return plan.CountLeastMemory();
+    }
+
+    uint64_t MemoryPlan::CountTmpTapesMemory(TapeSize size, TapeSize polyphase_tapes) {
+        TapeSize copies = polyphase_tapes != 0 ? polyphase_tapes : 2;
+        return sizeof(NumberType) * static_cast<uint64_t>(copies) * size;
+    }
+
+    uint64_t MemoryPlan::RoundToPages(uint64_t size) {
+        return size > kMinMergeChunkSize ? size / kMinMergeChunkSize * kMinMergeChunkSize : size;
+    }
+
+    ChunkSize MemoryPlan::FitChunkSize(const std::function<uint64_t(ChunkSize)> &count_memory) const {
+        ChunkSize max_size = std::max<TapeSize>(size_, 1);
+        ChunkSize fit = 0;
+        for (ChunkSize size = 1;; size *= 2) {
+            size = std::min(size, max_size);
+            if (count_memory(size) <= memory_) {
+                fit = size;
+            }
+            if (size == max_size) {
+                break;
+            }
+        }
+        if (fit == 0) {
+            return 0;
+        }
+
+        // The next size tried after the biggest one which fits does not fit, the sizes between them only grow the buffers.
+        ChunkSize too_big = fit == max_size ? max_size + 1 : std::min(2 * fit, max_size);
+        while (too_big - fit > 1) {
+            ChunkSize middle = fit + (too_big - fit) / 2;
+            if (count_memory(middle) <= memory_) {
+                fit = middle;
+            } else {
+                too_big = middle;
+            }
+        }
+        ChunkSize rounded = RoundToPages(fit);
+        return count_memory(rounded) <= memory_ ? rounded : fit;
+    }
+
+    uint64_t MemoryPlan::CountLeastPhaseMemory(const std::function<uint64_t(ChunkSize)> &count_memory) const {
+        ChunkSize max_size = std::max<TapeSize>(size_, 1);
+        uint64_t least = count_memory(max_size);
+        for (ChunkSize size = 1; size < max_size; size *= 2) {
+            least = std::min(least, count_memory(size));
+        }
+        return least;
+    }
+
+    uint64_t MemoryPlan::CountLeastMemory() const {
+        uint64_t least = CountLeastPhaseMemory([this](ChunkSize chunk_size) { return CountSplitMemory(chunk_size); });
+        if (options_.polyphase_tapes_ != 0) {
+            return least;
+        }
+        // The merges of a level run one at a time and merge two tapes at least.
+        uint64_t merge = CountLeastPhaseMemory([this](ChunkSize chunk_size) {
+            return CountMergeMemory(2, 1, chunk_size);
+        });
+        uint64_t final_merge = CountLeastPhaseMemory([this](ChunkSize chunk_size) {
+            return CountFinalMergeMemory(2, chunk_size);
+        });
+        return std::max({least, merge, final_merge});
+    }
+
+    TapeSize MemoryPlan::CountSplitBuffers() const {
+        // The chunk of the input tape being read (and the one read ahead) and its copy which is sorted
+        // with a scratch buffer. Several workers also keep a queue of the copies waiting to be sorted.
+        // Natural runs are appended, so the run also has two buffers of the appended numbers
+        // and the chunk of the last flush.
+        TapeSize read_ahead = options_.read_ahead_ ? 1 : 0;
+        if (options_.split_strategy_ == SplitStrategy::kNaturalRuns) {
+            return 6 + read_ahead;
+        }
+        if (options_.workers_ > 1) {
+            return 2 + read_ahead + 3 * options_.workers_;
+        }
+        return 3 + read_ahead;
+    }
+
+    TapeSize MemoryPlan::CountMergeBuffers(TapeSize ways) const {
+        TapeSize buffers = ways * (options_.read_ahead_ ? 3 : 2) + 4;
+        return ways == 2 ? buffers + 1 : buffers;
+    }
+
+    TapeSize MemoryPlan::CountPolyphaseBuffers() const {
+        // The distribution keeps the chunk of the input tape (and the one read ahead), its copy and the scratch buffer,
+        // two buffers of the appended numbers for every input tape and the chunk of the last flush.
+        // A phase keeps the chunks of the input tapes (and the ones read ahead), the buffer being filled,
+        // two buffers of the appended numbers and the chunk of the last flush.
+        TapeSize read_ahead = options_.read_ahead_ ? 1 : 0;
+        TapeSize inputs = options_.polyphase_tapes_ - 1;
+        return std::max<TapeSize>(4 + read_ahead + 2 * inputs, inputs * (1 + read_ahead) + 4);
+    }
+
+    TapeSize MemoryPlan::CountSortingThreads() const {
+        bool sort_chunks = options_.polyphase_tapes_ == 0 && options_.split_strategy_ == SplitStrategy::kSortChunks;
+        return sort_chunks && options_.workers_ > 1 ? options_.workers_ : 1;
+    }
+
+    uint64_t MemoryPlan::CountBuffersMemory(TapeSize buffers, ChunkSize chunk_size) const {
+        return buffers * static_cast<uint64_t>(ChunkPool::CountBlockMemory(chunk_size, options_.huge_pages_));
+    }
+
+    uint64_t MemoryPlan::CountInputMemory(ChunkSize chunk_size) const {
+        uint64_t device = StreamDevice::CountMemory(format_in_, chunk_size, false) +
+                          StreamDevice::CountOffsetsMemory(format_in_, size_, chunk_size);
+        return (options_.read_ahead_ ? 2 : 1) * device;
+    }
+
+    uint64_t MemoryPlan::CountRunMemory(TapeSize size, ChunkSize chunk_size, bool written) const {
+        uint64_t memory = 0;
+        if (options_.tmp_storage_ == TapeStorage::kStream) {
+            ChunkSize offsets_chunk_size = chunk_size;
+            if (!written && options_.split_strategy_ == SplitStrategy::kNaturalRuns && split_chunk_size_ != 0) {
+                // A descending run is read by the blocks of the greatest common divisor of the chunks,
+                // see ReversedDevice.
+                offsets_chunk_size = std::gcd(split_chunk_size_, chunk_size);
+            }
+            memory = StreamDevice::CountMemory(options_.tmp_format_, chunk_size, written) +
+                     StreamDevice::CountOffsetsMemory(options_.tmp_format_, size, offsets_chunk_size);
+        }
+        if (options_.split_strategy_ == SplitStrategy::kNaturalRuns) {
+            // The first natural run may be written to the output tape and merged from it.
+            memory = std::max(memory, StreamDevice::CountMemory(format_out_, chunk_size, written) +
+                                              StreamDevice::CountOffsetsMemory(format_out_, size, chunk_size));
+        }
+        return memory;
+    }
+
+    uint64_t MemoryPlan::CountSplitMemory(ChunkSize chunk_size) const {
+        uint64_t read_ahead = options_.read_ahead_ ? 1 : 0;
+        uint64_t radix_sort = chunk_size >= kRadixSortThreshold ? kRadixSortStackMemory : 0;
+        if (options_.polyphase_tapes_ != 0) {
+            // Every tape is written and then read ahead, and the input tape is read before the output tape is written.
+            uint64_t tapes = options_.polyphase_tapes_;
+            uint64_t output = StreamDevice::CountMemory(format_out_, chunk_size, true) +
+                              StreamDevice::CountOffsetsMemory(format_out_, size_, chunk_size);
+            return CountBuffersMemory(CountPolyphaseBuffers(), chunk_size) +
+                   tapes * CountRunMemory(size_, chunk_size, true) +
+                   (tapes - 1) * read_ahead * CountRunMemory(size_, chunk_size, false) +
+                   std::max(CountInputMemory(chunk_size), output) + radix_sort;
+        }
+        if (options_.split_strategy_ == SplitStrategy::kReplacementSelection) {
+            return CountBuffersMemory(kReplacementSelectionBuffers + read_ahead, chunk_size) +
+                   kHeapItemSize * 2 * chunk_size + CountInputMemory(chunk_size) +
+                   CountRunMemory(size_, chunk_size, true);
+        }
+        // Every sorting thread writes one run at once, the runs of the `sort` split are one chunk long.
+        TapeSize run_size = options_.split_strategy_ == SplitStrategy::kNaturalRuns ? size_ : chunk_size;
+        return CountBuffersMemory(CountSplitBuffers(), chunk_size) + CountInputMemory(chunk_size) +
+               CountSortingThreads() * (CountRunMemory(run_size, chunk_size, true) + radix_sort);
+    }
+
+    uint64_t MemoryPlan::CountMergeMemory(TapeSize ways, TapeSize merges, ChunkSize chunk_size) const {
+        // The tapes of a level hold the input tape together, so their offsets take no more than the offsets
+        // of one tape as big as the input tape and of the empty ones.
+        uint64_t inputs = CountRunMemory(size_, chunk_size, false) +
+                          (static_cast<uint64_t>(ways) * merges - 1) * CountRunMemory(0, chunk_size, false);
+        uint64_t outputs = CountRunMemory(size_, chunk_size, true) + (merges - 1) * CountRunMemory(0, chunk_size, true);
+        return merges * CountBuffersMemory(CountMergeBuffers(ways), chunk_size) +
+               (options_.read_ahead_ ? 2 : 1) * inputs + outputs;
+    }
+
+    uint64_t MemoryPlan::CountFinalMergeMemory(TapeSize ways, ChunkSize chunk_size) const {
+        uint64_t inputs = CountRunMemory(size_, chunk_size, false) + (ways - 1) * CountRunMemory(0, chunk_size, false);
+        uint64_t output = StreamDevice::CountMemory(format_out_, chunk_size, true) +
+                          StreamDevice::CountOffsetsMemory(format_out_, size_, chunk_size);
+        return CountBuffersMemory(CountMergeBuffers(ways), chunk_size) + (options_.read_ahead_ ? 2 : 1) * inputs +
+               output;
+    }
+} // namespace tape_structure
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "../tape.hpp"
+#include "sort_options.hpp"
+
+namespace tape_structure {
+    /**
+     * Division of the RAM memory between the buffers of the sorting.
+     * The phases of the sorting (split, every level of merges, final merge) do not overlap,
+     * so every phase may take all the memory. The plan counts everything a phase keeps in memory at once:
+     * the chunks of the tapes, the chunks read ahead, the double buffers of the appended numbers,
+     * the copies of the chunks and the scratch buffers of the sorting, the blocks of the pool
+     * (see ChunkPool::CountBlockMemory), the buffers and the offsets of the chunks of every open device
+     * (see StreamDevice::CountMemory) and the counts of the radix sort on the stack of every sorting thread.
+     * The runs are closed while they wait for the merge, so only the tapes of the running merges are open.
+     * The sorting takes no more than the memory then, except for the bookkeeping of the runs
+     * (a Tape object and a path for every run) and the pages of the storage the kernel maps or caches.
+     */
+    class MemoryPlan {
+    public:
+        MemoryPlan() = default;
+        /**
+         * Plan the buffers of the sorting.
+         * Throws std::invalid_argument if the memory is less than CountLeastMemory.
+         *
+         * @param memory memory for the buffers in bytes
+         * @param size size of the input tape
+         * @param options options of the sorting
+         * @param format_in format of the input tape
+         * @param format_out format of the output tape
+         */
+        MemoryPlan(MemorySize memory,
+                   TapeSize size,
+                   const SortOptions &options,
+                   TapeFormat format_in = TapeFormat::kText,
+                   TapeFormat format_out = TapeFormat::kText);
+
+        /**
+         * Get the size of the chunks the input tape is read by during the split.
+         * The runs of the `sort` split and of the polyphase merge are of this size.
+         *
+         * @return size of the chunks of the split
+         */
+        [[nodiscard]] ChunkSize GetSplitChunkSize() const;
+        /**
+         * Get the count of numbers in the heap of replacement selection.
+         *
+         * @return capacity of the heap
+         */
+        [[nodiscard]] size_t GetHeapCapacity() const;
+        /**
+         * Get the count of merges of one level running at once.
+         * It is limited by the workers, by the disk limit and by the memory:
+         * every merge needs at least a two-way merge worth of memory with chunks of kMinMergeChunkSize numbers.
+         *
+         * @return count of concurrent merges
+         */
+        [[nodiscard]] TapeSize GetParallelMerges() const;
+        /**
+         * Count how many tapes are merged at once by every one of the concurrent merges.
+         * The chunks should be at least kMinMergeChunkSize numbers, so the device is read in big blocks.
+         *
+         * @param count_of_tapes count of the sorted tapes
+         * @return count of tapes merged at once, from 2 to count_of_tapes
+         */
+        [[nodiscard]] TapeSize CountMergeWays(TapeSize count_of_tapes) const;
+        /**
+         * Count the size of the chunks of the merged tapes, so all the concurrent merges of a level fit in the memory.
+         *
+         * @param ways count of tapes merged at once
+         * @param merges count of concurrent merges
+         * @return size of one chunk
+         */
+        [[nodiscard]] ChunkSize CountMergeChunkSize(TapeSize ways, TapeSize merges = 1) const;
+        /**
+         * Count the size of the chunks of the final merge, which writes the output tape.
+         *
+         * @param ways count of tapes merged
+         * @return size of one chunk
+         */
+        [[nodiscard]] ChunkSize CountFinalMergeChunkSize(TapeSize ways) const;
+
+        /**
+         * Count the memory the pool may keep during the split (or the polyphase merge):
+         * all the planned chunks except the scratch buffers of the sorting, which are not taken from the pool.
+         *
+         * @return memory in bytes
+         */
+        [[nodiscard]] uint64_t CountSplitPoolMemory() const;
+        /**
+         * Count the memory the pool may keep during a level of merges or the final merge.
+         *
+         * @param ways count of tapes merged at once
+         * @param chunk_size size of the chunks of the merged tapes
+         * @param merges count of concurrent merges
+         * @return memory in bytes
+         */
+        [[nodiscard]] uint64_t CountMergePoolMemory(TapeSize ways, ChunkSize chunk_size, TapeSize merges = 1) const;
+
+        /**
+         * Count the memory taken by the busiest phase of the sorting.
+         * It is never greater than the memory of the plan.
+         *
+         * @param count_of_runs count of the runs after the split
+         * @return memory in bytes
+         */
+        [[nodiscard]] uint64_t CountPeakMemory(TapeSize count_of_runs) const;
+
+        /**
+         * Count the least memory the sorting can be planned with: every phase fits in it with some size of the chunks.
+         *
+         * @param size size of the input tape
+         * @param options options of the sorting
+         * @param format_in format of the input tape
+         * @param format_out format of the output tape
+         * @return memory in bytes
+         */
+        static uint64_t CountLeastMemory(TapeSize size,
+                                         const SortOptions &options,
+                                         TapeFormat format_in = TapeFormat::kText,
+                                         TapeFormat format_out = TapeFormat::kText);
+        /**
+         * Count the memory taken by the temporary tapes if they are kept in RAM.
+         * The tapes of one level are read while the tapes of the next level are written, so there are two copies
+         * of the tape, and every tape of the polyphase merge is created as big as the input tape.
+         *
+         * @param size size of the input tape
+         * @param polyphase_tapes count of temporary tapes of the polyphase merge (0 - it is not used)
+         * @return memory in bytes
+         */
+        static uint64_t CountTmpTapesMemory(TapeSize size, TapeSize polyphase_tapes);
+
+        /**
+         * Minimum size of the chunks of the merged tapes.
+         */
+        static constexpr ChunkSize kMinMergeChunkSize = 1024;
+
+    private:
+        /**
+         * Round the size of the chunks bigger than kMinMergeChunkSize down to a multiple of it,
+         * so the chunks are whole pages and the chunks of different tapes are multiples of each other
+         * (a reversed run is read by blocks of their greatest common divisor, see ReversedDevice).
+         *
+         * @param size size of the chunks
+         * @return rounded size
+         */
+        static uint64_t RoundToPages(uint64_t size);
+        /**
+         * Find the biggest size of the chunks whose phase fits in the memory, rounded to pages if it still fits.
+         * The buffers grow with the chunks, but the offsets of the chunks of the text tapes shrink,
+         * so the sizes are tried by powers of two first, and the biggest one which fits is refined.
+         *
+         * @param count_memory memory of the phase with the given size of the chunks
+         * @return size of the chunks, 0 if no size fits
+         */
+        [[nodiscard]] ChunkSize FitChunkSize(const std::function<uint64_t(ChunkSize)> &count_memory) const;
+        /**
+         * Count the least memory of the phase over the sizes of the chunks FitChunkSize tries.
+         *
+         * @param count_memory memory of the phase with the given size of the chunks
+         * @return memory in bytes
+         */
+        [[nodiscard]] uint64_t CountLeastPhaseMemory(const std::function<uint64_t(ChunkSize)> &count_memory) const;
+        /**
+         * Count the least memory every phase of the sorting fits in.
+         *
+         * @return memory in bytes
+         */
+        [[nodiscard]] uint64_t CountLeastMemory() const;
+
+        /**
+         * Count the chunks the split keeps in memory at once.
+         *
+         * @return count of chunks
+         */
+        [[nodiscard]] TapeSize CountSplitBuffers() const;
+        /**
+         * Count the chunks one merge keeps in memory at once.
+         * Every merged tape has its chunk (and the chunk read ahead) and its copy being merged,
+         * the merged tape has the buffer being filled, two buffers of the appended numbers
+         * and the chunk rewritten by the last flush. The buffer of the two-way merge is of two chunks.
+         *
+         * @param ways count of tapes merged at once
+         * @return count of chunks
+         */
+        [[nodiscard]] TapeSize CountMergeBuffers(TapeSize ways) const;
+        /**
+         * Count the chunks the polyphase merge keeps in memory at once,
+         * in the distribution of the runs or in a phase, whichever needs more.
+         *
+         * @return count of chunks
+         */
+        [[nodiscard]] TapeSize CountPolyphaseBuffers() const;
+        /**
+         * Count the threads which sort the runs of the split, each of them keeps a scratch buffer out of the pool.
+         *
+         * @return count of threads
+         */
+        [[nodiscard]] TapeSize CountSortingThreads() const;
+
+        /**
+         * Count the memory of the chunk buffers.
+         *
+         * @param buffers count of buffers
+         * @param chunk_size size of the chunks
+         * @return memory in bytes
+         */
+        [[nodiscard]] uint64_t CountBuffersMemory(TapeSize buffers, ChunkSize chunk_size) const;
+        /**
+         * Count the memory of the devices reading the input tape (the reader and the one reading ahead).
+         *
+         * @param chunk_size size of the chunks of the split
+         * @return memory in bytes
+         */
+        [[nodiscard]] uint64_t CountInputMemory(ChunkSize chunk_size) const;
+        /**
+         * Count the memory of the device of a run, a temporary tape or the output tape the first natural run
+         * is written to.
+         *
+         * @param size size of the run
+         * @param chunk_size size of the chunks of the run
+         * @param written the run is written, not only read
+         * @return memory in bytes
+         */
+        [[nodiscard]] uint64_t CountRunMemory(TapeSize size, ChunkSize chunk_size, bool written) const;
+        /**
+         * Count the memory of the split, or of the whole polyphase merge.
+         *
+         * @param chunk_size size of the chunks of the split
+         * @return memory in bytes
+         */
+        [[nodiscard]] uint64_t CountSplitMemory(ChunkSize chunk_size) const;
+        /**
+         * Count the memory of a level of merges writing temporary tapes.
+         *
+         * @param ways count of tapes merged at once
+         * @param merges count of concurrent merges
+         * @param chunk_size size of the chunks of the merged tapes
+         * @return memory in bytes
+         */
+        [[nodiscard]] uint64_t CountMergeMemory(TapeSize ways, TapeSize merges, ChunkSize chunk_size) const;
+        /**
+         * Count the memory of the final merge writing the output tape.
+         *
+         * @param ways count of tapes merged
+         * @param chunk_size size of the chunks of the merged tapes
+         * @return memory in bytes
+         */
+        [[nodiscard]] uint64_t CountFinalMergeMemory(TapeSize ways, ChunkSize chunk_size) const;
+
+        /**
+         * Memory for the buffers in bytes.
+         */
+        MemorySize memory_{};
+        /**
+         * Size of the input tape.
+         */
+        TapeSize size_{};
+        /**
+         * Options of the sorting.
+         */
+        SortOptions options_;
+        /**
+         * Format of the input tape.
+         */
+        TapeFormat format_in_ = TapeFormat::kText;
+        /**
+         * Format of the output tape.
+         */
+        TapeFormat format_out_ = TapeFormat::kText;
+
+        /**
+         * Size of the chunks of the split.
+         */
+        ChunkSize split_chunk_size_{};
+        /**
+         * Count of numbers in the heap of replacement selection.
+         */
+        size_t heap_capacity_{};
+        /**
+         * Count of merges of one level running at once.
+         */
+        TapeSize merges_{};
+    };
+} // namespace tape_structure
@@ -0,0 +1,19 @@
+#include "sort_options.hpp"
+
+#include <stdexcept>
+#include <string>
+
+namespace tape_structure {
+    SplitStrategy ParseSplitStrategy(std::string_view name) {
+        if (name.empty() || name == "sort") {
+            return SplitStrategy::kSortChunks;
+        }
+        if (name == "replacement_selection") {
+            return SplitStrategy::kReplacementSelection;
+        }
+        if (name == "natural") {
+            return SplitStrategy::kNaturalRuns;
+        }
+        throw std::invalid_argument("Unknown split strategy: " + std::string(name));
+    }
+} // namespace tape_structure
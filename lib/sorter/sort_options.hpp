@@ -0,0 +1,107 @@
+#pragma once
+
+#include <filesystem>
+#include <string_view>
+
+#include "../tape.hpp"
+
+namespace tape_structure {
+    /**
+     * Way to split the input tape into sorted runs (split tapes).
+     */
+    enum class SplitStrategy {
+        /**
+         * Every chunk of the input tape is sorted in memory, so all the runs are one chunk long.
+         */
+        kSortChunks,
+        /**
+         * Replacement selection: the numbers go through a heap, and a number is added to the current run
+         * if it is not less than the last number of the run. The runs are two heaps long on average
+         * on random data, and a nearly sorted tape gives one run.
+         */
+        kReplacementSelection,
+        /**
+         * Natural runs: the ascending and descending runs already present in the input tape are kept
+         * (the descending ones are read in the reverse order), only the chunks which are not sorted are sorted.
+         * A sorted tape is written right to the output tape in one pass.
+         */
+        kNaturalRuns
+    };
+
+    /**
+     * Get the split strategy by its name in the config ("sort", "replacement_selection" or "natural").
+     * An empty name means sorting the chunks.
+     *
+     * @param name name of the strategy
+     * @return split strategy
+     */
+    SplitStrategy ParseSplitStrategy(std::string_view name);
+
+    /**
+     * Options of the sorting.
+     */
+    struct SortOptions {
+        /**
+         * Storage of the temporary tapes.
+         */
+        TapeStorage tmp_storage_ = TapeStorage::kStream;
+        /**
+         * Format of the temporary tapes in files.
+         * The runs are sorted, so the compressed format takes a half to a quarter of the binary one on the disk,
+         * but the numbers are encoded and decoded on every pass.
+         */
+        TapeFormat tmp_format_ = TapeFormat::kBinary;
+        /**
+         * The input tape and the temporary tapes are read ahead.
+         */
+        bool read_ahead_ = false;
+        /**
+         * Way to split the input tape into sorted runs.
+         */
+        SplitStrategy split_strategy_ = SplitStrategy::kSortChunks;
+        /**
+         * Count of threads sorting the chunks of the input tape.
+         * Replacement selection and natural runs are sequential and always use one thread.
+         */
+        TapeSize workers_ = 1;
+        /**
+         * Maximum count of merges writing temporary tapes to the disk at once (0 - no limit).
+         * The merges of one level run in workers_ threads, it limits them further if the disk is the bottleneck.
+         * It does not apply to the temporary tapes in RAM.
+         */
+        TapeSize merge_io_limit_ = 0;
+        /**
+         * Count of temporary tapes of the polyphase merge (0 - polyphase merge is not used).
+         * The runs (sorted chunks of the input tape) are distributed over all the tapes but one
+         * according to the generalized Fibonacci numbers, and every phase merges them onto the remaining tape,
+         * so the sorting needs only this count of files however many runs there are.
+         * It should be at least 3.
+         */
+        TapeSize polyphase_tapes_ = 0;
+        /**
+         * Memory for the sorting in bytes (0 - Tape::kDivider times the chunk of the input tape
+         * over the least memory of MemoryPlan). The buffers of numbers and of the devices are planned by MemoryPlan,
+         * so they take no more than it.
+         */
+        MemorySize memory_ = 0;
+        /**
+         * The merges of the levels alternate between ascending and descending runs, and the runs
+         * are passed from the end, where the head is after they are written, so the temporary tapes
+         * are not rewound before they are merged. The final merge is ascending.
+         * The runs of the `sort` split are sorted in the order the first merges need, the runs of
+         * the other splits are ascending and are rewound if the first merges are ascending.
+         * The polyphase merge does not use it.
+         */
+        bool alternate_directions_ = false;
+        /**
+         * The chunk buffers of at least a huge page are aligned to it and are backed by transparent huge pages,
+         * so the big chunks take fewer page faults and TLB misses. It is a hint, the kernel may ignore it.
+         */
+        bool huge_pages_ = false;
+        /**
+         * Directory of the temporary tapes. It is created by the sorting, and the temporary tapes are removed
+         * from it after the sorting, so the sortings running at once should have different directories.
+         */
+        std::filesystem::path tmp_dir_ = "./tmp";
+    };
+} // namespace tape_structure
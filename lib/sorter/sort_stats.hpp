@@ -0,0 +1,30 @@
+#pragma once
+
+#include <set>
+#include <string>
+
+#include "../tape.hpp"
+
+namespace tape_structure {
+    /**
+     * Statistics of the sorting, they are counted while it runs.
+     */
+    struct SortStats {
+        /**
+         * Count of the runs the split makes (or the polyphase merge distributes).
+         */
+        TapeSize runs_ = 0;
+        /**
+         * Count of the levels of the merges, the final merge included (or of the phases of the polyphase merge).
+         */
+        TapeSize merge_levels_ = 0;
+        /**
+         * Names of all the temporary tapes created, relative to the directory of the temporary tapes.
+         */
+        std::set<std::string> tmp_tapes_;
+        /**
+         * Greatest count of the temporary tapes existing at once.
+         */
+        TapeSize max_tmp_tapes_ = 0;
+    };
+} // namespace tape_structure
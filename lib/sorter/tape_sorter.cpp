@@ -1,171 +1,825 @@
 #include "tape_sorter.hpp"
 
+#include <type_traits>
+
 namespace tape_structure {
-    TapeSorter::TapeSorter(Tape &tape_in, Tape &tape_out) : tape_in_(tape_in),
-                                                            tape_out_(tape_out) {}
+    namespace {
+        template <typename T>
+        T Invert(T number) {
+            if constexpr (std::is_floating_point_v<T>) {
+                return -number;
+            } else {
+                return ~number;
+            }
+        }
+
+        /**
+         * Invert the numbers (~x is -x - 1 for integers, floating-point numbers are negated), which reverses their order,
+         * so the descending runs are merged by the ascending merges. Inverting them again gives the numbers back.
+         *
+         * @param numbers numbers to invert
+         */
+        void InvertOrder(std::span<NumberType> numbers) {
+            for (NumberType &number: numbers) {
+                number = Invert(number);
+            }
+        }
+    } // namespace
+
+    TapeSorter::TapeSorter(Tape &tape_in, Tape &tape_out, SortOptions options) : tape_in_(tape_in),
+                                                                                 tape_out_(tape_out),
+                                                                                 dir_for_tmp_tapes_(options.tmp_dir_),
+                                                                                 options_(options),
+                                                                                 memory_(options.memory_ != 0
+                                                                                                 ? options.memory_
+                                                                                                 : tape_in.GetMaxChunkSize() *
+                                                                                                           Tape::kDivider +
+                                                                                                   MemoryPlan::CountLeastMemory(
+                                                                                                           tape_in.GetSize(),
+                                                                                                           options,
+                                                                                                           tape_in.GetFormat(),
+                                                                                                           tape_out.GetFormat())),
+                                                                                 plan_(memory_,
+                                                                                       tape_in.GetSize(),
+                                                                                       options,
+                                                                                       tape_in.GetFormat(),
+                                                                                       tape_out.GetFormat()),
+                                                                                 chunk_pool_(std::make_shared<ChunkPool>(
+                                                                                         options.huge_pages_)) {
+    }
 
     void TapeSorter::Sort() {
         std::filesystem::create_directories(dir_for_tmp_tapes_);
-        std::filesystem::path tmp_path(dir_for_tmp_tapes_);
-        TapeSize count_of_chunks = tape_in_.GetCountOfChunks();
-
-        std::vector<Tape> tapes(count_of_chunks, Tape(tape_in_.delays_));
+        chunk_pool_->SetLimit(plan_.CountSplitPoolMemory());
+        stats_ = SortStats();
+        if (options_.polyphase_tapes_ != 0) {
+            SortPolyphase();
+            RemoveTmpTapes(dir_for_tmp_tapes_);
+            return;
+        }
 
+        std::filesystem::path tmp_path(dir_for_tmp_tapes_);
+        std::vector<Tape> tapes;
         Split(tmp_path, tapes);
+        stats_.runs_ = tapes.size();
+        // The chunks of the merges are of another size than the chunks of the split.
+        chunk_pool_->Trim();
 
-        if (count_of_chunks == 1) {
+        if (tapes.size() == 1) {
             tape_out_ = std::move(tapes[0]);
         } else {
-            for (TapeSize i = count_of_chunks, j = 1; i != 2; i = (i - 1) / 2 + 1, j++) {
-                Assembly(j, tapes);
+            TapeSize merges = plan_.GetParallelMerges();
+            TapeSize ways = plan_.CountMergeWays(tapes.size());
+            ChunkSize chunk_size = plan_.CountMergeChunkSize(ways, merges);
+            chunk_pool_->SetLimit(plan_.CountMergePoolMemory(ways, chunk_size, merges));
+            TapeSize levels = CountMergeLevels(tapes.size());
+            bool descending_runs = descending_runs_;
+            for (TapeSize j = 1; tapes.size() > ways; j++) {
+                // The levels alternate the order, so that the last one is ascending.
+                bool descending = options_.alternate_directions_ && (levels - j) % 2 == 1;
+                Assembly(j, tapes, ways, chunk_size, merges, descending_runs, descending);
+                descending_runs = descending;
+                stats_.merge_levels_++;
                 std::filesystem::path prev(dir_for_tmp_tapes_);
                 prev += "/" + std::to_string(j - 1) + "/";
-                std::filesystem::remove_all(prev);
+                RemoveTmpTapes(prev);
+                chunk_pool_->Trim();
             }
 
-            tape_out_ = std::move(Merge(tape_out_.GetPath(), tapes[0], tapes[1]));
+            ChunkSize final_chunk_size = plan_.CountFinalMergeChunkSize(tapes.size());
+            chunk_pool_->SetLimit(plan_.CountMergePoolMemory(tapes.size(), final_chunk_size));
+            tape_out_ = Merge(tape_out_.GetPath(),
+                              tapes,
+                              final_chunk_size,
+                              tape_out_.GetFormat(),
+                              tape_out_.GetStorage(),
+                              descending_runs);
+            stats_.merge_levels_++;
         }
-        std::filesystem::remove_all(dir_for_tmp_tapes_);
+        RemoveTmpTapes(dir_for_tmp_tapes_);
+    }
+
+    std::chrono::milliseconds TapeSorter::GetSimulatedTime() const {
+        return tape_in_.delays_.GetTotalElapsed();
+    }
+
+    uint64_t TapeSorter::GetShiftCount() const {
+        return tape_in_.delays_.GetTotalShifts();
+    }
+
+    const SortStats &TapeSorter::GetStats() const {
+        return stats_;
+    }
+
+    TapeStorage TapeSorter::ChooseTmpStorage(MemorySize memory,
+                                             TapeSize size,
+                                             TapeStorage storage,
+                                             TapeSize polyphase_tapes) {
+        return 2 * MemoryPlan::CountTmpTapesMemory(size, polyphase_tapes) <= memory ? TapeStorage::kMemory : storage;
     }
 
-    Tape TapeSorter::Merge(std::filesystem::path path, Tape &tape1, Tape &tape2) {
-        std::pair<bool, bool> check_ends = {false, false};
+    void TapeSorter::SortPolyphase() {
+        if (options_.polyphase_tapes_ < 3) {
+            throw std::invalid_argument("Polyphase merge needs at least 3 tapes");
+        }
+        TapeSize inputs = options_.polyphase_tapes_ - 1;
+        ChunkSize chunk_size = plan_.GetSplitChunkSize();
 
-        std::fstream result_file_stream(path, std::fstream::out);
-        Tape result_tape(path, tape1.GetSize() + tape2.GetSize(), tape1.GetMaxChunkSize());
-        for (TapeSize i = 0; i < result_tape.GetCountOfChunks() - 1; i++) {
-            check_ends = MergeOneChunk(
-                    result_tape,
-                    tape1,
-                    tape2,
-                    check_ends.first,
-                    check_ends.second,
-                    result_tape.GetMaxChunkSize());
+        std::vector<PolyphaseTape> tapes(options_.polyphase_tapes_);
+        for (TapeSize i = 0; i < tapes.size(); i++) {
+            tapes[i].path_ = dir_for_tmp_tapes_;
+            tapes[i].path_ /= std::to_string(i) + ".tape";
+            ResetPolyphaseTape(tapes[i], chunk_size);
         }
-        MergeOneChunk(
-                result_tape,
-                tape1,
-                tape2,
-                check_ends.first,
-                check_ends.second,
-                result_tape.GetMinChunkSize());
 
-        result_file_stream.close();
-        tape1.ClearChunkInTape();
-        tape2.ClearChunkInTape();
+        // Distribution: perfect[j] is the count of runs on the j-th tape for the perfect distribution of the level,
+        // dummy_runs_ is how many of them are still missing.
+        std::vector<TapeSize> perfect(tapes.size(), 1);
+        perfect[inputs] = 0;
+        for (TapeSize j = 0; j < inputs; j++) {
+            tapes[j].dummy_runs_ = 1;
+        }
+        TapeSize level = 1;
+        {
+            Tape reader = MakeInputReader();
+            ChunkBuffer buffer(chunk_pool_);
+            std::vector<NumberType> scratch;
+            scratch.reserve(chunk_size);
+            TapeSize count_of_chunks = reader.GetCountOfChunks();
+            stats_.runs_ = count_of_chunks;
+            for (TapeSize i = 0, j = 0; i < count_of_chunks; i++) {
+                reader.ReadChunkToTheRight();
+                buffer.Assign(reader.GetChunkNumbers());
+                SortRun(buffer.GetNumbers(), scratch);
+                tapes[j].tape_->Append(buffer.GetNumbers());
+                tapes[j].runs_.push_back(buffer.GetSize());
+                tapes[j].dummy_runs_--;
 
-        return result_tape;
+                if (tapes[j].dummy_runs_ < tapes[j + 1].dummy_runs_) {
+                    j++;
+                    continue;
+                }
+                if (tapes[j].dummy_runs_ == 0) {
+                    level++;
+                    TapeSize first = perfect[0];
+                    for (TapeSize k = 0; k < inputs; k++) {
+                        tapes[k].dummy_runs_ = first + perfect[k + 1] - perfect[k];
+                        perfect[k] = first + perfect[k + 1];
+                    }
+                }
+                j = 0;
+            }
+        }
+        for (TapeSize j = 0; j < inputs; j++) {
+            TapeSize size = 0;
+            for (TapeSize run: tapes[j].runs_) {
+                size += run;
+            }
+            if (size != 0) {
+                tapes[j].tape_->Truncate(size);
+            }
+            tapes[j].tape_->SetReadAhead(options_.read_ahead_);
+        }
+
+        // Phases: every phase empties the last input tape, and the tapes are rotated so that it becomes the output.
+        for (; level > 0; level--) {
+            stats_.merge_levels_++;
+            std::unique_ptr<Tape> result;
+            if (level == 1) {
+                std::filesystem::path path_out = tape_out_.GetPath();
+                result = std::make_unique<Tape>(path_out,
+                                                tape_in_.GetSize(),
+                                                chunk_size,
+                                                tape_in_.delays_,
+                                                tape_out_.GetFormat(),
+                                                tape_out_.GetStorage());
+                result->SetChunkPool(chunk_pool_);
+                result->Create();
+            }
+            PolyphaseTape &output = tapes[inputs];
+            Tape &output_tape = result ? *result : *output.tape_;
+            output_tape.AdviseSequential();
+
+            for (TapeSize steps = tapes[inputs - 1].runs_.size() + tapes[inputs - 1].dummy_runs_; steps > 0; steps--) {
+                MergePolyphaseRuns(std::span(tapes).first(inputs), output, output_tape);
+            }
+            output_tape.Flush();
+
+            if (result) {
+                tape_out_ = std::move(*result);
+                break;
+            }
+            TapeSize size = 0;
+            for (TapeSize run: output.runs_) {
+                size += run;
+            }
+            if (size != 0) {
+                output.tape_->Truncate(size);
+            }
+            output.tape_->SetReadAhead(options_.read_ahead_);
+
+            std::rotate(tapes.begin(), tapes.begin() + inputs, tapes.end());
+            ResetPolyphaseTape(tapes[inputs], chunk_size);
+        }
     }
 
-    std::pair<bool, bool> TapeSorter::MergeOneChunk(Tape &tape_result,
-                                                    Tape &tape1,
-                                                    Tape &tape2,
-                                                    bool end1,
-                                                    bool end2,
-                                                    ChunkSize size) {
-        std::vector<NumberType> buffer;
-        if (end1 && !end2) {
-            PutTapeRestToBuffer(tape2, buffer, size);
-        } else if (end2 && !end1) {
-            PutTapeRestToBuffer(tape1, buffer, size);
+    void TapeSorter::ResetPolyphaseTape(PolyphaseTape &tape, ChunkSize chunk_size) {
+        tape.tape_.reset();
+        tape.tape_ = std::make_unique<Tape>(tape.path_,
+                                            tape_in_.GetSize(),
+                                            chunk_size,
+                                            tape_in_.delays_,
+                                            options_.tmp_format_,
+                                            options_.tmp_storage_);
+        tape.tape_->SetChunkPool(chunk_pool_);
+        tape.tape_->Create();
+        AddTmpTape(tape.path_);
+        tape.runs_.clear();
+        tape.dummy_runs_ = 0;
+    }
+
+    void TapeSorter::MergePolyphaseRuns(std::span<PolyphaseTape> inputs, PolyphaseTape &output, Tape &output_tape) {
+        std::vector<Tape *> sources;
+        std::vector<TapeSize> remaining;
+        for (PolyphaseTape &input: inputs) {
+            if (input.dummy_runs_ > 0) {
+                input.dummy_runs_--;
+            } else if (!input.runs_.empty()) {
+                sources.push_back(input.tape_.get());
+                remaining.push_back(input.runs_.front());
+                input.runs_.pop_front();
+            }
+        }
+        if (sources.empty()) {
+            output.dummy_runs_++;
+            return;
+        }
+
+        LoserTree tree(sources.size());
+        TapeSize run_size = 0;
+        for (size_t i = 0; i < sources.size(); i++) {
+            tree.SetNumber(i, sources[i]->GetCurrentNumber());
+            remaining[i]--;
+            run_size += remaining[i] + 1;
+        }
+        tree.Build();
+
+        ChunkBuffer buffer(output_tape.chunk_pool_);
+        buffer.Resize(output_tape.GetMaxChunkSize());
+        size_t count = 0;
+        while (!tree.IsEmpty()) {
+            buffer.GetData()[count++] = tree.GetWinnerNumber();
+            if (count == buffer.GetSize()) {
+                output_tape.Append(buffer.GetNumbers());
+                count = 0;
+            }
+
+            size_t winner = tree.GetWinner();
+            sources[winner]->MoveLeft();
+            if (remaining[winner] == 0) {
+                tree.ReplaceWinner(std::nullopt);
+            } else {
+                remaining[winner]--;
+                tree.ReplaceWinner(sources[winner]->GetCurrentNumber());
+            }
+        }
+        output_tape.Append(buffer.GetNumbers().first(count));
+        output.runs_.push_back(run_size);
+    }
+
+    TapeSorter::RunReader::RunReader(Tape &tape, bool backward, bool inverted) : tape_(tape),
+                                                                              backward_(backward),
+                                                                              inverted_(inverted),
+                                                                              copy_(tape.chunk_pool_) {}
+
+    std::span<const NumberType> TapeSorter::RunReader::GetRest() {
+        if (pos_ == chunk_.size() && read_chunks_ < tape_.GetCountOfChunks()) {
+            if (!backward_) {
+                tape_.ReadChunkToTheRight();
+            } else if (read_chunks_ == 0) {
+                tape_.ReadLastChunk();
+            } else {
+                tape_.ReadChunkToTheLeft();
+            }
+            chunk_ = tape_.GetChunkNumbers();
+            if (backward_ || inverted_) {
+                copy_.Assign(chunk_);
+                if (backward_) {
+                    std::reverse(copy_.GetData(), copy_.GetData() + copy_.GetSize());
+                }
+                if (inverted_) {
+                    InvertOrder(copy_.GetNumbers());
+                }
+                chunk_ = copy_.GetNumbers();
+            }
+            pos_ = 0;
+            read_chunks_++;
+        }
+        return std::span<const NumberType>(chunk_).subspan(pos_);
+    }
+
+    Tape TapeSorter::Merge(std::filesystem::path path,
+                           std::span<Tape> tapes,
+                           ChunkSize chunk_size,
+                           TapeFormat format, TapeStorage storage,
+                           bool descending_runs, bool descending) {
+        bool backward = descending_runs != descending;
+        TapeSize size = 0;
+        std::vector<Tape> views;
+        views.reserve(tapes.size());
+        for (Tape &tape: tapes) {
+            size += tape.GetSize();
+            views.emplace_back(tape.device_->Share(),
+                               tape.GetSize(),
+                               std::min(chunk_size, tape.GetSize()),
+                               tape.delays_);
+            views.back().SetChunkPool(tape.chunk_pool_);
+            views.back().head_ = tape.head_;
+            views.back().SetReadAhead(tape.read_ahead_);
+            if (!backward) {
+                views.back().AdviseSequential();
+            }
+        }
+        std::vector<RunReader> readers;
+        readers.reserve(views.size());
+        for (Tape &view: views) {
+            readers.emplace_back(view, backward, descending);
+        }
+
+        Tape result_tape(path, size, std::min(chunk_size, size), tapes.front().delays_, format, storage);
+        result_tape.SetChunkPool(tapes.front().chunk_pool_);
+        result_tape.Create();
+        result_tape.AdviseSequential();
+
+        if (readers.size() == 2) {
+            MergeTwo(readers[0], readers[1], result_tape, descending);
         } else {
-            while (buffer.size() != size) {
-                while (buffer.size() != size) {
-                    if (tape1.GetCurrentNumber() < tape2.GetCurrentNumber()) {
-                        if (PutNumberInBuffer(tape1, buffer, end1)) {
-                            break;
-                        }
-                    } else if (tape1.GetCurrentNumber() >= tape2.GetCurrentNumber()) {
-                        if (PutNumberInBuffer(tape2, buffer, end2)) {
-                            break;
-                        }
-                    }
+            LoserTree tree(readers.size());
+            for (size_t i = 0; i < readers.size(); i++) {
+                tree.SetNumber(i, readers[i].GetRest().front());
+            }
+            tree.Build();
+
+            ChunkBuffer buffer(result_tape.chunk_pool_);
+            buffer.Resize(result_tape.GetMaxChunkSize());
+            size_t count = 0;
+            while (!tree.IsEmpty()) {
+                buffer.GetData()[count++] = tree.GetWinnerNumber();
+                if (count == buffer.GetSize()) {
+                    AppendMerged(result_tape, buffer.GetNumbers(), descending);
+                    count = 0;
                 }
-                if (buffer.size() != size) {
-                    if (!end1 && end2) {
-                        PutTapeRestToBuffer(tape1, buffer, size);
-                    } else if (end1 && !end2) {
-                        PutTapeRestToBuffer(tape2, buffer, size);
-                    }
+
+                RunReader &winner = readers[tree.GetWinner()];
+                winner.pos_++;
+                std::span<const NumberType> rest = winner.GetRest();
+                tree.ReplaceWinner(rest.empty() ? std::nullopt : std::optional(rest.front()));
+            }
+            AppendMerged(result_tape, buffer.GetNumbers().first(count), descending);
+        }
+
+        result_tape.Flush();
+        result_tape.SetReadAhead(tapes.front().read_ahead_);
+
+        return result_tape;
+    }
+
+    void TapeSorter::MergeTwo(RunReader &first, RunReader &second, Tape &result_tape, bool inverted) {
+        ChunkBuffer buffer(result_tape.chunk_pool_);
+        for (;;) {
+            std::span<const NumberType> first_rest = first.GetRest();
+            std::span<const NumberType> second_rest = second.GetRest();
+            if (first_rest.empty() && second_rest.empty()) {
+                break;
+            }
+
+            // The numbers up to the smaller of the last numbers of the chunks can be merged,
+            // the numbers after it are merged with the next chunk.
+            size_t first_count = first_rest.size();
+            size_t second_count = second_rest.size();
+            if (!first_rest.empty() && !second_rest.empty()) {
+                if (first_rest.back() <= second_rest.back()) {
+                    second_count = std::upper_bound(second_rest.begin(), second_rest.end(), first_rest.back()) -
+                                   second_rest.begin();
+                } else {
+                    first_count = std::upper_bound(first_rest.begin(), first_rest.end(), second_rest.back()) -
+                                  first_rest.begin();
                 }
             }
+
+            buffer.Resize(first_count + second_count);
+            MergeSorted(first_rest.first(first_count), second_rest.first(second_count), buffer.GetData());
+            AppendMerged(result_tape, buffer.GetNumbers(), inverted);
+            first.pos_ += first_count;
+            second.pos_ += second_count;
         }
+    }
 
-        for (NumberType &number: buffer) {
-            tape_result.Put(number);
-            tape_result.MoveLeft();
+    void TapeSorter::AppendMerged(Tape &tape, std::span<NumberType> numbers, bool inverted) {
+        if (inverted) {
+            InvertOrder(numbers);
+        }
+        tape.Append(numbers);
+    }
+
+    TapeSize TapeSorter::CountMergeLevels(TapeSize count_of_runs) const {
+        if (count_of_runs <= 1) {
+            return 0;
+        }
+        TapeSize ways = plan_.CountMergeWays(count_of_runs);
+        TapeSize levels = 1;
+        for (TapeSize count = count_of_runs; count > ways; count = (count - 1) / ways + 1) {
+            levels++;
         }
+        return levels;
+    }
+
+    void TapeSorter::AddTmpTape(const std::filesystem::path &path) {
+        std::lock_guard lock(stats_mutex_);
+        stats_.tmp_tapes_.insert(path.lexically_relative(dir_for_tmp_tapes_).generic_string());
+        tmp_tapes_.insert(path.string());
+        stats_.max_tmp_tapes_ = std::max<TapeSize>(stats_.max_tmp_tapes_, tmp_tapes_.size());
+    }
+
+    void TapeSorter::RemoveTmpTapes(const std::filesystem::path &path) {
+        std::filesystem::remove_all(path);
+        std::lock_guard lock(stats_mutex_);
+        // The paths of the tapes are made by appending to the paths of their directories.
+        std::erase_if(tmp_tapes_, [&path](const std::string &tape) { return tape.starts_with(path.string()); });
+    }
 
-        return {end1, end2};
+    Tape TapeSorter::MakeInputReader() {
+        Tape reader(tape_in_.device_->Share(), tape_in_.GetSize(), plan_.GetSplitChunkSize(), tape_in_.delays_);
+        reader.SetChunkPool(chunk_pool_);
+        reader.SetReadAhead(options_.read_ahead_);
+        return reader;
     }
 
     void TapeSorter::Split(std::filesystem::path &path, std::vector<Tape> &tapes) {
         path += "/" + std::to_string(0) + "/";
         std::filesystem::create_directories(path);
-        TapeSize count_of_chunks = tape_in_.GetCountOfChunks();
+        if (options_.split_strategy_ == SplitStrategy::kReplacementSelection) {
+            SplitByReplacementSelection(path, tapes);
+            return;
+        }
+        if (options_.split_strategy_ == SplitStrategy::kNaturalRuns) {
+            SplitByNaturalRuns(path, tapes);
+            return;
+        }
+
+        TapeSize count_of_runs = (tape_in_.GetSize() - 1) / plan_.GetSplitChunkSize() + 1;
+        descending_runs_ = options_.alternate_directions_ && CountMergeLevels(count_of_runs) % 2 == 1;
+        if (options_.workers_ > 1) {
+            SplitInParallel(path, tapes);
+            return;
+        }
+
+        Tape reader = MakeInputReader();
+        ChunkBuffer buffer(chunk_pool_);
+        std::vector<NumberType> scratch;
+        scratch.reserve(plan_.GetSplitChunkSize());
+        TapeSize count_of_chunks = reader.GetCountOfChunks();
+        tapes.resize(count_of_chunks, Tape(tape_in_.delays_));
         for (TapeSize i = 0; i < count_of_chunks; i++) {
-            MakeSplitTape(path, tapes[i], i);
+            reader.ReadChunkToTheRight();
+            buffer.Assign(reader.GetChunkNumbers());
+            MakeSplitTape(path, tapes[i], i, buffer.GetNumbers(), scratch);
         }
     }
 
-    void TapeSorter::MakeSplitTape(std::filesystem::path &path, Tape &tape, TapeSize tape_number) {
-        std::filesystem::path tmp_file = path;
-        tmp_file += std::to_string(tape_number) + ".txt";
-        std::fstream stream_to(tmp_file, std::fstream::out);
+    void TapeSorter::SplitInParallel(std::filesystem::path &path, std::vector<Tape> &tapes) {
+        using SplitChunk = std::pair<TapeSize, ChunkBuffer>;
+
+        TapeSize workers = options_.workers_;
+        Tape reader = MakeInputReader();
+        TapeSize count_of_chunks = reader.GetCountOfChunks();
+        tapes.resize(count_of_chunks, Tape(tape_in_.delays_));
+
+        BoundedQueue<SplitChunk> queue(workers);
+        std::vector<std::future<void>> sorted;
+        for (TapeSize i = 0; i < workers; i++) {
+            sorted.push_back(std::async(std::launch::async, [this, &path, &tapes, &queue]() {
+                try {
+                    std::vector<NumberType> scratch;
+                    scratch.reserve(plan_.GetSplitChunkSize());
+                    while (std::optional<SplitChunk> chunk = queue.Pop()) {
+                        MakeSplitTape(path, tapes[chunk->first], chunk->first, chunk->second.GetNumbers(), scratch);
+                    }
+                } catch (...) {
+                    queue.Close();
+                    throw;
+                }
+            }));
+        }
+
+        try {
+            for (TapeSize i = 0; i < count_of_chunks; i++) {
+                reader.ReadChunkToTheRight();
+                // The copy is sorted by a worker while the next chunk is read, its buffer goes back to the pool then.
+                ChunkBuffer chunk(chunk_pool_);
+                chunk.Assign(reader.GetChunkNumbers());
+                if (!queue.Push({i, std::move(chunk)})) {
+                    break;
+                }
+            }
+        } catch (...) {
+            queue.Close();
+            throw;
+        }
+        queue.Close();
+        for (std::future<void> &worker: sorted) {
+            worker.get();
+        }
+    }
+
+    void TapeSorter::SplitByReplacementSelection(std::filesystem::path &path, std::vector<Tape> &tapes) {
+        using HeapItem = std::pair<TapeSize, NumberType>;
+
+        Tape reader = MakeInputReader();
+        ChunkSize chunk_size = plan_.GetSplitChunkSize();
+        size_t heap_capacity = plan_.GetHeapCapacity();
+        std::vector<HeapItem> heap;
+        heap.reserve(heap_capacity);
+        std::vector<NumberType> buffer;
+        buffer.reserve(chunk_size);
+
+        TapeSize count_of_chunks = reader.GetCountOfChunks();
+        TapeSize read_chunks = 0;
+        std::span<const NumberType> chunk;
+        size_t chunk_pos = 0;
+        auto read_number = [&](NumberType &number) {
+            if (chunk_pos == chunk.size()) {
+                if (read_chunks == count_of_chunks) {
+                    return false;
+                }
+                reader.ReadChunkToTheRight();
+                chunk = reader.GetChunkNumbers();
+                chunk_pos = 0;
+                read_chunks++;
+            }
+            number = chunk[chunk_pos++];
+            return true;
+        };
 
-        tape_in_.ReadChunkToTheRight();
+        for (NumberType number; heap.size() < heap_capacity && read_number(number);) {
+            heap.emplace_back(0, number);
+        }
+        std::make_heap(heap.begin(), heap.end(), std::greater<>());
+
+        TapeSize written = 0;
+        TapeSize run_size = 0;
+        Tape run;
+        auto finish_run = [&]() {
+            run.Append(buffer);
+            buffer.clear();
+            run.Truncate(run_size);
+            run.SetReadAhead(options_.read_ahead_);
+            tapes.push_back(std::move(run));
+            tapes.back().Close();
+            run_size = 0;
+        };
+        auto start_run = [&]() {
+            std::filesystem::path tmp_file = path;
+            tmp_file += std::to_string(tapes.size()) + ".tape";
+            run = Tape(tmp_file,
+                       tape_in_.GetSize() - written,
+                       std::min(chunk_size, tape_in_.GetSize() - written),
+                       tape_in_.delays_,
+                       options_.tmp_format_,
+                       options_.tmp_storage_);
+            run.SetChunkPool(chunk_pool_);
+            run.Create();
+            AddTmpTape(tmp_file);
+        };
 
-        std::vector<NumberType> buffer = tape_in_.GetChunkNumbers();
-        std::sort(buffer.begin(), buffer.end());
+        start_run();
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+            auto [run_number, number] = heap.back();
+            heap.pop_back();
+            if (run_number != tapes.size()) {
+                finish_run();
+                start_run();
+            }
+
+            buffer.push_back(number);
+            written++;
+            run_size++;
+            if (buffer.size() == chunk_size) {
+                run.Append(buffer);
+                buffer.clear();
+            }
 
-        for (NumberType &number: buffer) {
-            stream_to << number << ' ';
+            if (NumberType next; read_number(next)) {
+                heap.emplace_back(next < number ? run_number + 1 : run_number, next);
+                std::push_heap(heap.begin(), heap.end(), std::greater<>());
+            }
         }
+        finish_run();
+    }
+
+    void TapeSorter::SplitByNaturalRuns(std::filesystem::path &path, std::vector<Tape> &tapes) {
+        Tape reader = MakeInputReader();
+        ChunkSize chunk_size = plan_.GetSplitChunkSize();
+        ChunkBuffer chunk_buffer(chunk_pool_);
+        std::vector<NumberType> scratch;
+        scratch.reserve(chunk_size);
+
+        std::error_code error;
+        bool to_output = !std::filesystem::equivalent(tape_in_.GetPath(), tape_out_.GetPath(), error);
+        TapeSize read = 0;
+        std::unique_ptr<Tape> run;
+        TapeSize run_size = 0;
+        bool descending = false;
+        // The last number of the ascending run or the smallest number of the descending one.
+        NumberType last{};
+
+        auto start_run = [&](bool descending_run) {
+            bool output_run = to_output && tapes.empty() && !descending_run;
+            std::filesystem::path tmp_file = path;
+            tmp_file += std::to_string(tapes.size()) + ".tape";
+            if (output_run) {
+                tmp_file = tape_out_.GetPath();
+            }
+            TapeSize capacity = tape_in_.GetSize() - read;
+            run = std::make_unique<Tape>(tmp_file,
+                                         capacity,
+                                         std::min(chunk_size, capacity),
+                                         tape_in_.delays_,
+                                         output_run ? tape_out_.GetFormat() : options_.tmp_format_,
+                                         output_run ? tape_out_.GetStorage() : options_.tmp_storage_);
+            run->SetChunkPool(chunk_pool_);
+            run->Create();
+            if (!output_run) {
+                AddTmpTape(tmp_file);
+            }
+            run_size = 0;
+            descending = descending_run;
+        };
+        auto append = [&](std::span<const NumberType> numbers) {
+            run->Append(numbers);
+            run_size += numbers.size();
+        };
+        auto finish_run = [&]() {
+            if (!run) {
+                return;
+            }
+            run->Truncate(run_size);
+            if (descending && run_size > chunk_size) {
+                tapes.emplace_back(std::make_unique<ReversedDevice>(run->device_->Share(), chunk_size),
+                                   run_size,
+                                   chunk_size,
+                                   tape_in_.delays_);
+            } else if (run->GetPath() == tape_out_.GetPath() && run_size != tape_in_.GetSize()) {
+                // Another run follows, so the output tape is needed for the merge.
+                std::filesystem::path tmp_file = path;
+                tmp_file += std::to_string(tapes.size()) + ".tape";
+                std::filesystem::path output = run->GetPath();
+                TapeFormat format = run->GetFormat();
+                TapeStorage storage = run->GetStorage();
+                run.reset();
+                Tape::MoveFile(output, tmp_file);
+                AddTmpTape(tmp_file);
+                tapes.emplace_back(tmp_file,
+                                   run_size,
+                                   std::min(chunk_size, run_size),
+                                   tape_in_.delays_,
+                                   format,
+                                   storage);
+            } else {
+                tapes.push_back(std::move(*run));
+            }
+            tapes.back().SetReadAhead(options_.read_ahead_);
+            tapes.back().Close();
+            run.reset();
+        };
+
+        TapeSize count_of_chunks = reader.GetCountOfChunks();
+        for (TapeSize i = 0; i < count_of_chunks; i++) {
+            reader.ReadChunkToTheRight();
+            chunk_buffer.Assign(reader.GetChunkNumbers());
+            std::span<NumberType> chunk = chunk_buffer.GetNumbers();
+            std::span<NumberType> rest(chunk);
+            bool chunk_descending = chunk.size() == chunk_size && chunk.front() > chunk.back() &&
+                                    std::is_sorted(chunk.rbegin(), chunk.rend());
 
-        stream_to.close();
-        Tape result_tape(tmp_file, buffer.size(), buffer.size());
+            if (run && descending) {
+                if (chunk_descending && chunk.front() <= last) {
+                    last = chunk.back();
+                    std::reverse(chunk.begin(), chunk.end());
+                    append(chunk);
+                    rest = {};
+                } else {
+                    finish_run();
+                }
+            } else if (run) {
+                size_t count = chunk.front() < last
+                                       ? 0
+                                       : std::is_sorted_until(chunk.begin(), chunk.end()) - chunk.begin();
+                append(rest.first(count));
+                rest = rest.subspan(count);
+                if (count != 0) {
+                    last = chunk[count - 1];
+                }
+                if (!rest.empty()) {
+                    finish_run();
+                }
+            }
+
+            read += chunk.size() - rest.size();
+            if (rest.empty()) {
+                continue;
+            }
+            if (rest.size() == chunk.size() && chunk_descending) {
+                start_run(true);
+                last = chunk.back();
+                std::reverse(chunk.begin(), chunk.end());
+            } else {
+                start_run(false);
+                if (std::is_sorted(rest.rbegin(), rest.rend())) {
+                    std::reverse(rest.begin(), rest.end());
+                } else {
+                    SortRun(rest, scratch);
+                }
+                last = rest.back();
+            }
+            append(rest);
+            read += rest.size();
+        }
+        finish_run();
+    }
+
+    void TapeSorter::MakeSplitTape(const std::filesystem::path &path,
+                                   Tape &tape,
+                                   TapeSize tape_number,
+                                   std::span<NumberType> buffer,
+                                   std::vector<NumberType> &scratch) {
+        std::filesystem::path tmp_file = path;
+        tmp_file += std::to_string(tape_number) + ".tape";
+
+        SortRun(buffer, scratch);
+        if (descending_runs_) {
+            std::reverse(buffer.begin(), buffer.end());
+        }
+
+        Tape result_tape(tmp_file,
+                         buffer.size(),
+                         buffer.size(),
+                         tape_in_.delays_,
+                         options_.tmp_format_,
+                         options_.tmp_storage_);
+        result_tape.SetChunkPool(chunk_pool_);
+        result_tape.Create();
+        AddTmpTape(tmp_file);
+        result_tape.AppendChunk(buffer);
+        result_tape.Flush();
         tape = std::move(result_tape);
+        tape.SetReadAhead(options_.read_ahead_);
+        tape.Close();
     }
 
-    void TapeSorter::Assembly(TapeSize dir, std::vector<Tape> &tapes) {
+    void TapeSorter::Assembly(TapeSize dir,
+                              std::vector<Tape> &tapes,
+                              TapeSize ways,
+                              ChunkSize chunk_size,
+                              TapeSize merges,
+                              bool descending_runs,
+                              bool descending) {
         std::filesystem::path curr_path(dir_for_tmp_tapes_);
         curr_path += "/" + std::to_string(dir) + "/";
         std::filesystem::create_directories(curr_path);
 
         TapeSize tapes_size = tapes.size();
-        std::vector<Tape> new_tapes(tapes_size % 2 == 0
-                                            ? tapes_size / 2
-                                            : tapes_size / 2 + 1);
-        TapeSize i = 0;
-        for (TapeSize j = 0; i < tapes_size / 2; i++, j += 2) {
-            std::filesystem::path tmp_file = curr_path;
-            tmp_file += std::to_string(i) + ".txt";
-            new_tapes[i] = std::move(Merge(tmp_file, tapes[j], tapes[j + 1]));
-        }
-        if (tapes_size % 2 != 0) {
-            std::filesystem::path tmp_file = curr_path;
-            tmp_file += std::to_string(i) + ".txt";
-            std::fstream stream_out(tmp_file, std::fstream::out);
-            Tape curr_tape(tapes[tapes_size - 1], tmp_file);
-            new_tapes[new_tapes.size() - 1] = curr_tape;
-        }
-        tapes.clear();
-        tapes = new_tapes;
-    }
+        TapeSize count_of_groups = (tapes_size - 1) / ways + 1;
+        std::vector<Tape> new_tapes(count_of_groups);
+        std::atomic<TapeSize> next_group = 0;
+        auto merge_groups = [&]() {
+            for (TapeSize i; (i = next_group++) < count_of_groups;) {
+                TapeSize begin = static_cast<uint64_t>(tapes_size) * i / count_of_groups;
+                TapeSize end = static_cast<uint64_t>(tapes_size) * (i + 1) / count_of_groups;
 
-    void TapeSorter::PutTapeRestToBuffer(Tape &tape, std::vector<NumberType> &buffer, ChunkSize size) {
-        buffer.push_back(tape.GetCurrentNumber());
-        while (tape.MoveLeft() && buffer.size() != size) {
-            buffer.push_back(tape.GetCurrentNumber());
-        }
-    }
+                std::filesystem::path tmp_file = curr_path;
+                tmp_file += std::to_string(i) + ".tape";
+                AddTmpTape(tmp_file);
+                new_tapes[i] = Merge(tmp_file,
+                                     std::span(tapes).subspan(begin, end - begin),
+                                     chunk_size,
+                                     options_.tmp_format_,
+                                     options_.tmp_storage_,
+                                     descending_runs,
+                                     descending);
+                new_tapes[i].Close();
+            }
+        };
 
-    bool TapeSorter::PutNumberInBuffer(Tape &tape, std::vector<NumberType> &buffer, bool &end) {
-        buffer.push_back(tape.GetCurrentNumber());
-        if (!tape.MoveLeft()) {
-            end = true;
-            return true;
+        std::vector<std::future<void>> merged;
+        for (TapeSize i = 1; i < std::min(merges, count_of_groups); i++) {
+            merged.push_back(std::async(std::launch::async, merge_groups));
+        }
+        merge_groups();
+        for (std::future<void> &merge: merged) {
+            merge.get();
         }
-        return false;
+        tapes = std::move(new_tapes);
     }
-} // namespace tape_structure
\ No newline at end of file
+} // namespace tape_structure
@@ -1,14 +1,28 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <span>
 
+#include "../device/reversed_device.hpp"
+#include "../merge/loser_tree.hpp"
+#include "../merge/merge_kernel.hpp"
+#include "../parallel/bounded_queue.hpp"
+#include "../sorting/run_sort.hpp"
 #include "../tape.hpp"
+#include "memory_plan.hpp"
+#include "sort_options.hpp"
+#include "sort_stats.hpp"
 
 namespace tape_structure {
     class TapeSorter {
     public:
         TapeSorter() = default;
-        TapeSorter(Tape &tape_in, Tape &tape_out);
+        TapeSorter(Tape &tape_in, Tape &tape_out, SortOptions options = SortOptions());
 
         ~TapeSorter() = default;
 
@@ -17,32 +31,213 @@ namespace tape_structure {
          */
         void Sort();
 
+        /**
+         * Get the simulated time of the operations of the input tape and of all the tapes of the sorting
+         * created with its delays (the temporary tapes and the output tape).
+         *
+         * @return simulated time
+         */
+        [[nodiscard]] std::chrono::milliseconds GetSimulatedTime() const;
+        /**
+         * Get the count of the positions the tapes of the sorting have moved by (see GetSimulatedTime),
+         * counted if the delay for shift is set.
+         *
+         * @return count of the positions
+         */
+        [[nodiscard]] uint64_t GetShiftCount() const;
+        /**
+         * Get the statistics of the last sorting: the runs, the levels of the merges and the temporary tapes.
+         *
+         * @return statistics
+         */
+        [[nodiscard]] const SortStats &GetStats() const;
+
+        /**
+         * Choose the storage of the temporary tapes.
+         * They are kept in RAM if they take at most half of the memory (MemoryPlan::CountTmpTapesMemory),
+         * the other half is left for the buffers.
+         *
+         * @param memory RAM memory
+         * @param size size of the tape
+         * @param storage storage used if the tapes do not fit in the memory
+         * @param polyphase_tapes count of temporary tapes of the polyphase merge (0 - it is not used)
+         * @return storage of the temporary tapes
+         */
+        static TapeStorage ChooseTmpStorage(MemorySize memory,
+                                            TapeSize size,
+                                            TapeStorage storage,
+                                            TapeSize polyphase_tapes = 0);
+
     private:
         /**
-         * Merge two sorted tapes into one sorted tape.
+         * Temporary tape of the polyphase merge.
+         */
+        struct PolyphaseTape {
+            /**
+             * Path to the file of the tape.
+             */
+            std::filesystem::path path_;
+            /**
+             * The tape. The runs are appended to it when it is the output of the phase
+             * and are read from the beginning when it is an input.
+             */
+            std::unique_ptr<Tape> tape_;
+            /**
+             * Sizes of the real runs which have not been read yet.
+             */
+            std::deque<TapeSize> runs_;
+            /**
+             * Count of dummy (empty) runs before the real ones.
+             */
+            TapeSize dummy_runs_{};
+        };
+
+        /**
+         * Reader of a sorted tape by its chunks for the merges.
+         * The tape is passed from the beginning or, so that it is not rewound after it is written, from the end.
+         * The numbers of a chunk are reversed if the tape is passed from the end, and they are inverted
+         * if the merged runs are descending (see InvertOrder), so the merges always merge ascending numbers.
+         */
+        struct RunReader {
+            /**
+             * Create a reader of a sorted tape which has not been read yet.
+             * The copies of the chunks are taken from the chunk pool of the tape.
+             *
+             * @param tape view of the sorted tape
+             * @param backward the tape is passed from the end
+             * @param inverted the numbers are inverted
+             */
+            RunReader(Tape &tape, bool backward, bool inverted);
+
+            /**
+             * View of the sorted tape.
+             */
+            Tape &tape_;
+            /**
+             * The tape is passed from the end.
+             */
+            bool backward_{};
+            /**
+             * The numbers are inverted.
+             */
+            bool inverted_{};
+            /**
+             * Numbers of the current chunk: the chunk of the tape itself, or its copy
+             * if the numbers are reversed or inverted.
+             */
+            std::span<const NumberType> chunk_;
+            /**
+             * Position of the first number of the chunk which has not been merged yet.
+             */
+            size_t pos_{};
+            /**
+             * Count of the chunks read.
+             */
+            TapeSize read_chunks_{};
+            /**
+             * Buffer of the reversed or inverted copy of the chunk.
+             */
+            ChunkBuffer copy_;
+
+            /**
+             * Get the numbers of the current chunk which have not been merged yet.
+             * The next chunk is read when all the numbers of the current one are merged.
+             *
+             * @return numbers which have not been merged yet, empty at the end of the tape
+             */
+            std::span<const NumberType> GetRest();
+        };
+
+        /**
+         * Sort the input tape by the polyphase merge with SortOptions::polyphase_tapes_ tapes.
+         * The distribution and the phases follow Algorithm D from Knuth, The Art of Computer Programming, 5.4.2.
+         * The last phase is written right to the output tape.
+         */
+        void SortPolyphase();
+        /**
+         * Make the polyphase tape empty and ready to append runs.
+         *
+         * @param tape polyphase tape
+         * @param chunk_size size of the chunks of the tape
+         */
+        void ResetPolyphaseTape(PolyphaseTape &tape, ChunkSize chunk_size);
+        /**
+         * Merge one run (real or dummy) from every input tape of the phase onto the output tape.
+         *
+         * @param inputs input tapes of the phase
+         * @param output output tape of the phase
+         * @param output_tape tape where the merged run is appended
+         */
+        static void MergePolyphaseRuns(std::span<PolyphaseTape> inputs, PolyphaseTape &output, Tape &output_tape);
+
+        /**
+         * Merge two sorted tapes chunk by chunk with the vectorized kernel (MergeSorted).
+         *
+         * @param first reader of the first sorted tape
+         * @param second reader of the second sorted tape
+         * @param result_tape tape where the merged numbers are appended
+         * @param inverted the numbers of the readers are inverted
+         */
+        static void MergeTwo(RunReader &first, RunReader &second, Tape &result_tape, bool inverted);
+        /**
+         * Append the merged numbers to the tape, inverting them back if they are inverted.
+         *
+         * @param tape tape where the numbers are appended
+         * @param numbers merged numbers
+         * @param inverted the numbers are inverted
+         */
+        static void AppendMerged(Tape &tape, std::span<NumberType> numbers, bool inverted);
+
+        /**
+         * Merge sorted tapes into one sorted tape using the tree of losers (two tapes are merged by MergeTwo).
+         * The merged tapes are read through their own views, so they are not changed.
+         * A tape sorted in the other order than the new one is passed from the end, where its head is
+         * after it is written, so it is not rewound (SortOptions::alternate_directions_).
+         * The new tape is read ahead if the first tape is.
          *
          * @param path path to the file of new tape file to which the result is written
-         * @param tape1 first sorted tape
-         * @param tape2 second sorted tape
-         * @return sorted tape consisting of two introductory tapes
+         * @param tapes sorted tapes
+         * @param chunk_size size of the chunks the tapes are read and written by
+         * @param format format of the new tape file
+         * @param storage storage of the new tape
+         * @param descending_runs the tapes are sorted in the descending order
+         * @param descending the new tape is sorted in the descending order
+         * @return sorted tape consisting of all the introductory tapes
          */
-        static Tape Merge(std::filesystem::path path, Tape &tape1, Tape &tape2);
+        static Tape Merge(std::filesystem::path path,
+                          std::span<Tape> tapes,
+                          ChunkSize chunk_size,
+                          TapeFormat format, TapeStorage storage,
+                          bool descending_runs = false, bool descending = false);
         /**
-         * Create new sorted chunk from two tapes by merging.
+         * Count the levels of the merges of the runs, the final merge included.
          *
-         * @param tape_result writing a new chunk to this tape
-         * @param tape1 first sorted resource tape
-         * @param tape2 second sorted resource tape
-         * @param end1 true if the position on the tape1 is the rightmost and the tape1 is passed to the end
-         * @param end2 true if the position on the tape2 is the rightmost and the tape2 is passed to the end
-         * @param size size of new chunk
-         * @return new value of end1 and end2 params
+         * @param count_of_runs count of the runs after the split
+         * @return count of the levels, 0 for one run
          */
-        static std::pair<bool, bool> MergeOneChunk(Tape &tape_result,
-                                                   Tape &tape1, Tape &tape2,
-                                                   bool end1, bool end2,
-                                                   ChunkSize size);
+        [[nodiscard]] TapeSize CountMergeLevels(TapeSize count_of_runs) const;
 
+        /**
+         * Count the temporary tape in the statistics of the sorting.
+         * It can be called from several threads at once.
+         *
+         * @param path path to the tape
+         */
+        void AddTmpTape(const std::filesystem::path &path);
+        /**
+         * Remove the directory of the temporary tapes, its tapes are not counted as existing any more.
+         *
+         * @param path path to the directory
+         */
+        void RemoveTmpTapes(const std::filesystem::path &path);
+
+        /**
+         * Make a view of the input tape which is read by the chunks of the split (MemoryPlan::GetSplitChunkSize).
+         * The chunks of the input tape itself are not used, so they do not take memory.
+         *
+         * @return view of the input tape
+         */
+        Tape MakeInputReader();
         /**
          * Starting splitting tapes into array of tapes.
          *
@@ -51,39 +246,72 @@ namespace tape_structure {
          */
         void Split(std::filesystem::path &path, std::vector<Tape> &tapes);
         /**
-         * Create a new split tape.
+         * Split the input tape by sorting its chunks in several threads.
+         * The chunks are read one after another and passed to the sorting threads through a bounded queue.
+         * Every chunk in memory (the one being read, the queued ones and the ones being sorted)
+         * is counted in the memory, so the chunks are smaller than the chunks of the input tape.
          *
-         * @param path path to the file where new tape will be located.
-         * @param tape new tape
-         * @param tape_number number of new tape
+         * @param path file path where the tapes should be stored
+         * @param tapes split tapes
          */
-        void MakeSplitTape(std::filesystem::path &path, Tape &tape, TapeSize tape_number);
-
+        void SplitInParallel(std::filesystem::path &path, std::vector<Tape> &tapes);
         /**
-         * Starting of the assembly of split tapes together.
+         * Split the input tape by replacement selection.
+         * The heap holds as many numbers as two chunks of the split.
          *
-         * @param dir
+         * @param path file path where the tapes should be stored
          * @param tapes split tapes
          */
-        void Assembly(TapeSize dir, std::vector<Tape> &tapes);
-
+        void SplitByReplacementSelection(std::filesystem::path &path, std::vector<Tape> &tapes);
+        /**
+         * Split the input tape into the natural runs, like the natural merge sort.
+         * Every chunk continues the current ascending run as far as it is sorted and not less than the run.
+         * Descending chunks that follow each other are reversed and kept as one descending run,
+         * which is read by its chunks in the reverse order (ReversedDevice).
+         * The rest of the chunk starts a new run: it is reversed if it is descending and sorted if it is not sorted.
+         * The first run is appended right to the output tape, so a sorted tape is sorted in one pass,
+         * and it is moved to the temporary tapes if another run follows.
+         *
+         * @param path file path where the tapes should be stored
+         * @param tapes split tapes
+         */
+        void SplitByNaturalRuns(std::filesystem::path &path, std::vector<Tape> &tapes);
         /**
-         * Put the remaining numbers of the tape in the buffer.
+         * Create a new split tape.
+         * It can be called from several threads at once for different tapes.
          *
-         * @param tape tape from which the current number is taken
-         * @param buffer buffer of numbers
-         * @param size size that the buffer should have
+         * @param path path to the file where new tape will be located.
+         * @param tape new tape
+         * @param tape_number number of new tape
+         * @param buffer numbers of the chunk of the input tape, they are sorted in place
+         * @param scratch scratch buffer of the sorting of the thread
          */
-        static void PutTapeRestToBuffer(Tape &tape, std::vector<NumberType> &buffer, ChunkSize size);
+        void MakeSplitTape(const std::filesystem::path &path,
+                           Tape &tape,
+                           TapeSize tape_number,
+                           std::span<NumberType> buffer,
+                           std::vector<NumberType> &scratch);
+
         /**
-         * Put the current number from the tape (indicated by the magnetic head) in the buffer.
+         * Merge every group of at most `ways` split tapes into one tape.
+         * The groups are independent, so they are merged in several threads:
+         * every thread takes the next group which has not been taken yet.
          *
-         * @param tape tape from which the current number is taken
-         * @param buffer buffer of numbers
-         * @param end true if the magnetic head points to the rightmost position of the tape else false
-         * @return true if the magnetic head points to the rightmost position of the tape else false
+         * @param dir number of the directory for the new tapes
+         * @param tapes split tapes, they are replaced with the merged ones
+         * @param ways count of tapes merged at once
+         * @param chunk_size size of the chunks the tapes are read and written by
+         * @param merges count of groups merged at once
+         * @param descending_runs the split tapes are sorted in the descending order
+         * @param descending the merged tapes are sorted in the descending order
          */
-        bool static PutNumberInBuffer(Tape &tape, std::vector<NumberType> &buffer, bool &end);
+        void Assembly(TapeSize dir,
+                      std::vector<Tape> &tapes,
+                      TapeSize ways,
+                      ChunkSize chunk_size,
+                      TapeSize merges,
+                      bool descending_runs,
+                      bool descending);
 
         /**
          * Tape that needs to be sorted.
@@ -94,7 +322,45 @@ namespace tape_structure {
          */
         Tape tape_out_;
 
-        const std::filesystem::path dir_for_tmp_tapes_ = "./tmp";
+        /**
+         * Directory of the temporary tapes (see SortOptions::tmp_dir_).
+         */
+        const std::filesystem::path dir_for_tmp_tapes_;
+        /**
+         * Options of the sorting.
+         */
+        SortOptions options_;
+        /**
+         * Memory for the sorting (SortOptions::memory_ or Tape::kDivider times the chunk of the input tape
+         * over the least memory of the plan).
+         */
+        MemorySize memory_{};
+        /**
+         * Division of the memory between the buffers.
+         */
+        MemoryPlan plan_;
+        /**
+         * Pool of the chunk buffers of all the tapes of the sorting.
+         * The tapes made from the tapes of the pool (the views and the results of the merges) take it too.
+         */
+        std::shared_ptr<ChunkPool> chunk_pool_;
+        /**
+         * The split tapes are sorted in the descending order, so that the merges of the levels
+         * alternate the directions and the final merge is ascending (SortOptions::alternate_directions_).
+         */
+        bool descending_runs_ = false;
+        /**
+         * Statistics of the last sorting.
+         */
+        SortStats stats_;
+        /**
+         * Temporary tapes existing now.
+         */
+        std::set<std::string> tmp_tapes_;
+        /**
+         * Guards stats_ and tmp_tapes_, the temporary tapes are created by the workers too.
+         */
+        std::mutex stats_mutex_;
     };
 
 } // namespace tape_structure
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "run_sort.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace tape_structure {
+    namespace {
+        constexpr uint32_t kDigitBits = kRadixDigitBits;
+        constexpr uint32_t kDigitValues = 1 << kDigitBits;
+        constexpr uint32_t kDigitMask = kDigitValues - 1;
+
+        /**
+         * Unsigned integer of the size of the number, whose order is the order of the numbers.
+         */
+        template <typename T>
+        using Key = std::conditional_t<sizeof(T) == sizeof(uint64_t), uint64_t, uint32_t>;
+
+        template <typename T>
+        constexpr uint32_t kDigitsCount = (8 * sizeof(Key<T>) + kDigitBits - 1) / kDigitBits;
+
+        /**
+         * Get the key of the number: the sign bit of the signed integers is flipped, so negative numbers go first.
+         * The positive floating-point numbers get the sign bit too, and the negative ones are inverted whole,
+         * so the bigger their magnitude the smaller the key.
+         */
+        template <typename T>
+        Key<T> GetKey(T number) {
+            static_assert(sizeof(T) == sizeof(uint32_t) || sizeof(T) == sizeof(uint64_t),
+                          "RadixSort sorts 32-bit and 64-bit numbers");
+            constexpr Key<T> kSignBit = Key<T>{1} << (8 * sizeof(Key<T>) - 1);
+            if constexpr (std::is_floating_point_v<T>) {
+                auto bits = std::bit_cast<Key<T>>(number);
+                return (bits & kSignBit) != 0 ? ~bits : bits | kSignBit;
+            } else if constexpr (std::is_signed_v<T>) {
+                return static_cast<Key<T>>(number) ^ kSignBit;
+            } else {
+                return number;
+            }
+        }
+
+        template <typename T>
+        uint32_t Digit(T number, uint32_t digit) {
+            return static_cast<uint32_t>(GetKey(number) >> (digit * kDigitBits)) & kDigitMask;
+        }
+    } // namespace
+
+    void SortRun(std::span<NumberType> numbers) {
+        if (numbers.size() < kRadixSortThreshold) {
+            std::sort(numbers.begin(), numbers.end());
+            return;
+        }
+        RadixSort(numbers);
+    }
+
+    void SortRun(std::span<NumberType> numbers, std::vector<NumberType> &scratch) {
+        if (numbers.size() < kRadixSortThreshold) {
+            std::sort(numbers.begin(), numbers.end());
+            return;
+        }
+        RadixSort(numbers, scratch);
+    }
+
+    void RadixSort(std::span<NumberType> numbers) {
+        thread_local std::vector<NumberType> scratch;
+        RadixSort(numbers, scratch);
+    }
+
+    template <typename T>
+    void RadixSort(std::span<T> numbers, std::vector<T> &scratch) {
+        scratch.resize(numbers.size());
+
+        std::array<std::array<size_t, kDigitValues>, kDigitsCount<T>> counts{};
+        for (T number: numbers) {
+            for (uint32_t digit = 0; digit < kDigitsCount<T>; digit++) {
+                counts[digit][Digit(number, digit)]++;
+            }
+        }
+
+        std::span<T> from = numbers;
+        std::span<T> to = scratch;
+        for (uint32_t digit = 0; digit < kDigitsCount<T>; digit++) {
+            std::array<size_t, kDigitValues> &offsets = counts[digit];
+            if (std::find(offsets.begin(), offsets.end(), numbers.size()) != offsets.end()) {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (size_t &count: offsets) {
+                size_t current = count;
+                count = offset;
+                offset += current;
+            }
+            for (T number: from) {
+                to[offsets[Digit(number, digit)]++] = number;
+            }
+            std::swap(from, to);
+        }
+
+        if (from.data() != numbers.data()) {
+            std::copy(from.begin(), from.end(), numbers.begin());
+        }
+    }
+
+    template void RadixSort(std::span<int32_t> numbers, std::vector<int32_t> &scratch);
+    template void RadixSort(std::span<uint32_t> numbers, std::vector<uint32_t> &scratch);
+    template void RadixSort(std::span<int64_t> numbers, std::vector<int64_t> &scratch);
+    template void RadixSort(std::span<uint64_t> numbers, std::vector<uint64_t> &scratch);
+    template void RadixSort(std::span<float> numbers, std::vector<float> &scratch);
+    template void RadixSort(std::span<double> numbers, std::vector<double> &scratch);
+} // namespace tape_structure
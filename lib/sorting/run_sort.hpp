@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "../chunk/chunk.hpp"
+
+namespace tape_structure {
+    /**
+     * Sort the numbers of a run (a chunk of the input tape) in memory.
+     * Big runs are sorted by RadixSort, small ones by std::sort.
+     *
+     * @param numbers numbers of the run
+     */
+    void SortRun(std::span<NumberType> numbers);
+    /**
+     * Sort the numbers of a run with the scratch buffer of the caller,
+     * so the caller decides how long the buffer is kept.
+     *
+     * @param numbers numbers of the run
+     * @param scratch scratch buffer, it is resized to the size of the run
+     */
+    void SortRun(std::span<NumberType> numbers, std::vector<NumberType> &scratch);
+
+    /**
+     * LSD radix sort by 11-bit digits: three passes for 32-bit numbers, six for 64-bit ones.
+     * The sign bit is flipped, so negative numbers go first (negative floating-point numbers are inverted whole).
+     * The counts of all digits are taken in one pass, and a pass is skipped if all the numbers have the same digit.
+     * The numbers are moved between them and a scratch buffer of the same size,
+     * the buffer is kept for the thread and reused by the next calls.
+     *
+     * @param numbers numbers to sort
+     */
+    void RadixSort(std::span<NumberType> numbers);
+    /**
+     * LSD radix sort with the scratch buffer of the caller.
+     * It is instantiated for the 32-bit and 64-bit integers, float and double, whatever NumberType is.
+     *
+     * @param numbers numbers to sort
+     * @param scratch scratch buffer, it is resized to the size of numbers
+     */
+    template <typename T>
+    void RadixSort(std::span<T> numbers, std::vector<T> &scratch);
+
+    /**
+     * Runs shorter than this are sorted by std::sort, the passes of the radix sort do not pay off for them.
+     */
+    constexpr size_t kRadixSortThreshold = 512;
+    /**
+     * Bits of a digit of the radix sort.
+     */
+    constexpr uint32_t kRadixDigitBits = 11;
+    /**
+     * Memory the radix sort takes on the stack of the sorting thread: the counts of the values of all the digits.
+     */
+    constexpr size_t kRadixSortStackMemory =
+            (8 * sizeof(NumberType) + kRadixDigitBits - 1) / kRadixDigitBits * (size_t{1} << kRadixDigitBits) *
+            sizeof(size_t);
+} // namespace tape_structure
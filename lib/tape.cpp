@@ -1,115 +1,377 @@
 #include "tape.hpp"
 
+#include <cerrno>
+#include <string>
+#include <system_error>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace tape_structure {
-    Tape::Tape(Delays delays) : delays_(delays) {}
+    namespace {
+        /**
+         * Count of numbers rewritten at once, a multiple of the blocks of the compressed tapes.
+         */
+        constexpr size_t kRewriteBlockSize = 4 * compressed_format::kBlockLength;
+
+        /**
+         * Copy the file in the kernel, so the numbers are neither parsed nor copied through the user space:
+         * as a reflink (the copy shares the blocks of the file until they are changed) if the file system
+         * supports it, else by copy_file_range.
+         *
+         * @param from path to the source file
+         * @param to path to the copy, it is overwritten
+         */
+        void CopyFile(const std::filesystem::path &from, const std::filesystem::path &to) {
+#ifdef __linux__
+            int in = ::open(from.c_str(), O_RDONLY);
+            if (in < 0) {
+                throw std::system_error(errno, std::generic_category(), "Failed to open " + from.string());
+            }
+            int out = ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (out < 0) {
+                int error = errno;
+                ::close(in);
+                throw std::system_error(error, std::generic_category(), "Failed to open " + to.string());
+            }
+
+            bool copied = ::ioctl(out, FICLONE, in) == 0;
+            struct stat info{};
+            if (!copied && ::fstat(in, &info) == 0) {
+                off_t left = info.st_size;
+                for (ssize_t done; left > 0 && (done = ::copy_file_range(in, nullptr, out, nullptr, left, 0)) > 0;) {
+                    left -= done;
+                }
+                copied = left == 0;
+            }
+            ::close(in);
+            ::close(out);
+            if (copied) {
+                return;
+            }
+#endif
+            std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing);
+        }
+
+        /**
+         * Read the next block of numbers of the tape.
+         *
+         * @return count of numbers read
+         */
+        size_t ReadBlock(std::fstream &from, text_format::TextReader &text_reader, std::string &encoded,
+                         TapeFormat format, std::vector<NumberType> &block) {
+            if (format == TapeFormat::kBinary) {
+                return binary_format::ReadNumbers(from, block.data(), block.size());
+            }
+            if (format == TapeFormat::kCompressed) {
+                size_t count = 0;
+                while (count + compressed_format::kBlockLength <= block.size()) {
+                    uint32_t read = compressed_format::ReadBlock(from, encoded, block.data() + count).count_;
+                    count += read;
+                    if (read < compressed_format::kBlockLength) {
+                        break;
+                    }
+                }
+                return count;
+            }
+            return text_reader.ReadNumbers(block.data(), block.size());
+        }
+
+        void WriteBlock(std::fstream &to, TapeFormat format, const std::vector<NumberType> &block, size_t count,
+                        std::string &text) {
+            if (format == TapeFormat::kBinary) {
+                binary_format::WriteNumbers(to, block.data(), count);
+                return;
+            }
+            text.clear();
+            if (format == TapeFormat::kCompressed) {
+                for (size_t i = 0; i < count; i += compressed_format::kBlockLength) {
+                    compressed_format::AppendBlock(text, block.data() + i,
+                                                   std::min(count - i, compressed_format::kBlockLength));
+                }
+            } else {
+                text_format::AppendNumbers(text, block.data(), count);
+            }
+            to.write(text.data(), static_cast<std::streamsize>(text.size()));
+        }
+
+        std::ios::openmode OpenMode(TapeFormat format) {
+            return format != TapeFormat::kText
+                           ? std::ios::in | std::ios::out | std::ios::binary
+                           : std::ios::in | std::ios::out;
+        }
+    } // namespace
+
+    Tape::Tape(Delays delays) : delays_(delays.ForTape()) {}
 
     Tape::Tape(std::chrono::milliseconds delay_for_read,
                std::chrono::milliseconds delay_for_put,
-               std::chrono::milliseconds delay_for_shift) : delays_(delay_for_read, delay_for_put, delay_for_shift) {}
+               std::chrono::milliseconds delay_for_shift) : Tape(Delays(delay_for_read, delay_for_put, delay_for_shift)) {}
 
     Tape::Tape(std::filesystem::path& path,
                std::chrono::milliseconds delay_for_read,
                std::chrono::milliseconds delay_for_put,
-               std::chrono::milliseconds delay_for_shift) : path_(path),
-                                                            delays_(delay_for_read, delay_for_put, delay_for_shift) {}
+               std::chrono::milliseconds delay_for_shift,
+               TapeFormat format,
+               TapeStorage storage) : Tape(path, Delays(delay_for_read, delay_for_put, delay_for_shift), format, storage) {}
 
-    Tape::Tape(std::filesystem::path& path, Delays delays) : path_(path),
-                                                             delays_(delays) {}
+    Tape::Tape(std::filesystem::path& path,
+               Delays delays,
+               TapeFormat format,
+               TapeStorage storage) : delays_(delays.ForTape()),
+                                      path_(path),
+                                      format_(format),
+                                      storage_(storage),
+                                      device_(MakeTapeDevice(path, format, storage)) {}
 
     Tape::Tape(std::filesystem::path& path,
                TapeSize tape_size,
                ChunkSize chunk_size,
                std::chrono::milliseconds delay_for_read,
                std::chrono::milliseconds delay_for_put,
-               std::chrono::milliseconds delay_for_shift) : path_(path),
-                                                            delays_(delay_for_read, delay_for_put, delay_for_shift),
-                                                            size_(tape_size) {
+               std::chrono::milliseconds delay_for_shift,
+               TapeFormat format,
+               TapeStorage storage) : Tape(path,
+                                           tape_size,
+                                           chunk_size,
+                                           Delays(delay_for_read, delay_for_put, delay_for_shift),
+                                           format,
+                                           storage) {}
+
+    Tape::Tape(std::filesystem::path& path,
+               TapeSize tape_size,
+               ChunkSize chunk_size,
+               Delays delays,
+               TapeFormat format,
+               TapeStorage storage) : delays_(delays.ForTape()),
+                                      path_(path),
+                                      format_(format),
+                                      storage_(storage),
+                                      device_(MakeTapeDevice(path, format, storage)),
+                                      size_(tape_size) {
         chunks_info_ = ChunksInfo(chunk_size, size_);
         current_chunk_ = Chunk(delays_, 0, chunks_info_.max_size_chunk_);
-        stream_from_.open(path_);
     }
 
-    Tape::Tape(std::filesystem::path& path, TapeSize tape_size, ChunkSize chunk_size)
-        : Tape(path, tape_size, chunk_size, 0ms, 0ms, 0ms) {}
+    Tape::Tape(std::filesystem::path& path,
+               TapeSize tape_size,
+               ChunkSize chunk_size,
+               TapeFormat format,
+               TapeStorage storage) : Tape(path, tape_size, chunk_size, Delays(), format, storage) {}
+
+    Tape::Tape(std::unique_ptr<TapeDevice> device,
+               TapeSize tape_size,
+               ChunkSize chunk_size,
+               Delays delays) : delays_(delays.ForTape()),
+                                format_(device->GetFormat()),
+                                storage_(device->GetStorage()),
+                                device_(std::move(device)),
+                                size_(tape_size) {
+        chunks_info_ = ChunksInfo(chunk_size, size_);
+        current_chunk_ = Chunk(delays_, 0, chunks_info_.max_size_chunk_);
+    }
 
-    Tape::Tape(const Tape& other) : path_(other.path_),
-                                    delays_(other.delays_),
+    Tape::Tape(const Tape& other) : delays_(other.delays_),
+                                    path_(other.path_),
+                                    format_(other.format_),
+                                    storage_(other.storage_),
+                                    device_(other.device_ ? other.device_->Share() : nullptr),
                                     size_(other.size_),
+                                    head_(other.head_),
+                                    to_the_left_(other.to_the_left_),
                                     chunks_info_(other.chunks_info_),
-                                    current_chunk_(other.current_chunk_) {}
+                                    current_chunk_(other.current_chunk_),
+                                    read_ahead_(other.read_ahead_),
+                                    chunk_pool_(other.chunk_pool_),
+                                    append_buffer_(other.chunk_pool_),
+                                    write_buffer_(other.chunk_pool_) {}
+
+    void Tape::RewriteFromTo(std::fstream& from, TapeFormat from_format,
+                             std::fstream& to, TapeFormat to_format) {
+        bool from_is_empty = from.peek() == std::char_traits<char>::eof();
+        if (from_format != TapeFormat::kText && !from_is_empty) {
+            ReadTapeHeader(from, from_format);
+        }
+        if (to_format != TapeFormat::kText) {
+            WriteTapeHeader(to, to_format, {sizeof(NumberType), 0});
+        }
+
+        uint64_t count = 0;
+        std::vector<NumberType> block(kRewriteBlockSize);
+        text_format::TextReader text_reader(from);
+        std::string encoded;
+        std::string text;
+        for (size_t read = 0;
+             !from_is_empty && (read = ReadBlock(from, text_reader, encoded, from_format, block)) != 0;) {
+            WriteBlock(to, to_format, block, read, text);
+            count += read;
+        }
 
-    void Tape::RewriteFromTo(std::fstream& from, std::fstream& to) {
-        NumberType num;
-        while (from >> num) {
-            to << num << ' ';
+        if (to_format != TapeFormat::kText) {
+            to.seekp(0);
+            WriteTapeHeader(to, to_format, {sizeof(NumberType), count});
         }
     }
 
-    Tape::Tape(const Tape& other, std::filesystem::path& path) : Tape(other) {
+    void Tape::Convert(const std::filesystem::path& from, TapeFormat from_format,
+                       const std::filesystem::path& to, TapeFormat to_format) {
+        std::fstream from_file(from, OpenMode(from_format));
+        std::fstream to_file(to, OpenMode(to_format) | std::ios::trunc);
+        RewriteFromTo(from_file, from_format, to_file, to_format);
+    }
+
+    void Tape::MoveFile(const std::filesystem::path& from, const std::filesystem::path& to) {
+        std::error_code error;
+        std::filesystem::rename(from, to, error);
+        if (error) {
+            CopyFile(from, to);
+            std::filesystem::remove(from);
+        }
+    }
+
+    Tape::Tape(Tape& other, std::filesystem::path& path) : Tape(other) {
+        other.Flush();
         path_ = path;
-        stream_from_.open(path_);
-        std::fstream other_file(other.path_);
-        RewriteFromTo(other_file, stream_from_);
-        stream_from_.close();
-        other_file.close();
+        device_ = MakeTapeDevice(path_, format_, storage_);
+        if (!other.path_.empty() && storage_ != TapeStorage::kMemory) {
+            CopyFile(other.path_, path_);
+            return;
+        }
+        Create();
+
+        std::unique_ptr<TapeDevice> other_device = other.device_->Share();
+        other_device->Open(size_, chunks_info_.max_size_chunk_);
+        RewriteFrom(*other_device);
+        Flush();
     }
 
     Tape& Tape::operator=(const Tape& other) {
+        if (&other == this) {
+            return *this;
+        }
+
+        Flush();
+        DropReadAhead();
+        read_ahead_device_.reset();
         path_ = other.path_;
+        format_ = other.format_;
+        storage_ = other.storage_;
+        device_ = other.device_ ? other.device_->Share() : nullptr;
         delays_ = other.delays_;
         size_ = other.size_;
+        head_ = other.head_;
+        to_the_left_ = other.to_the_left_;
         chunks_info_ = other.chunks_info_;
         current_chunk_ = other.current_chunk_;
-        unused_ = other.unused_;
-
-        if (exists(path_)) {
-            if (stream_from_.is_open()) {
-                stream_from_.close();
-            }
-            stream_from_.open(path_, std::ios::in | std::ios::out);
-            std::fstream other_file(other.path_);
-            RewriteFromTo(other_file, stream_from_);
-            stream_from_.close();
-        } else {
-            path_ = other.path_;
+        unused_ = true;
+        read_ahead_ = other.read_ahead_;
+        if (chunk_pool_ != other.chunk_pool_) {
+            WaitWriteBehind();
+            chunk_pool_ = other.chunk_pool_;
+            append_buffer_ = ChunkBuffer(chunk_pool_);
+            write_buffer_ = ChunkBuffer(chunk_pool_);
         }
 
         return *this;
     }
 
     Tape::Tape(Tape&& other) noexcept {
-        *this = std::move(other);
+        // The background tasks use the members of the other tape, so they are finished before the members are taken.
+        // The error of the writing behind is kept in its future and is thrown by this tape.
+        other.DropReadAhead();
+        if (other.written_.valid()) {
+            other.written_.wait();
+        }
+
+        std::swap(other.delays_, delays_);
+        std::swap(other.path_, path_);
+        std::swap(other.format_, format_);
+        std::swap(other.storage_, storage_);
+        std::swap(other.device_, device_);
+        std::swap(other.size_, size_);
+        std::swap(other.head_, head_);
+        std::swap(other.to_the_left_, to_the_left_);
+        std::swap(other.chunks_info_, chunks_info_);
+        std::swap(other.current_chunk_, current_chunk_);
+        std::swap(other.unused_, unused_);
+        std::swap(other.read_ahead_, read_ahead_);
+        std::swap(other.read_ahead_device_, read_ahead_device_);
+        std::swap(other.chunk_pool_, chunk_pool_);
+        std::swap(other.next_chunk_, next_chunk_);
+        std::swap(other.appended_, appended_);
+        std::swap(other.append_buffer_, append_buffer_);
+        std::swap(other.write_buffer_, write_buffer_);
+        std::swap(other.written_, written_);
     }
 
-    Tape& Tape::operator=(Tape&& other) noexcept {
+    Tape& Tape::operator=(Tape&& other) {
         if (&other == this) {
             return *this;
         }
+        other.Flush();
+        other.DropReadAhead();
+        DropReadAhead();
+        WaitWriteBehind();
+
+        std::error_code error;
+        bool keeps_device = device_ && !(exists(path_) && std::filesystem::equivalent(path_, other.path_, error));
+        bool takes_file = keeps_device && !other.path_.empty() && other.format_ == format_ &&
+                          other.storage_ != TapeStorage::kMemory && storage_ != TapeStorage::kMemory;
+        if (keeps_device && !takes_file) {
+            // The numbers are rewritten from the device of the other tape,
+            // so it is opened with its own size and chunks before they are swapped.
+            other.Open();
+        }
 
         std::swap(other.delays_, delays_);
         std::swap(other.size_, size_);
+        std::swap(other.head_, head_);
+        std::swap(other.to_the_left_, to_the_left_);
         std::swap(other.chunks_info_, chunks_info_);
         std::swap(other.current_chunk_, current_chunk_);
         std::swap(other.unused_, unused_);
-
-        if (exists(path_)) {
-            if (stream_from_.is_open()) stream_from_.close();
-            stream_from_.open(path_, std::ios::in | std::ios::out);
-            other.stream_from_.close();
-            other.stream_from_.open(other.path_, std::ios::in | std::ios::out);
-            RewriteFromTo(other.stream_from_, stream_from_);
-            stream_from_.close();
+        std::swap(other.read_ahead_, read_ahead_);
+        std::swap(other.read_ahead_device_, read_ahead_device_);
+        std::swap(other.chunk_pool_, chunk_pool_);
+        std::swap(other.appended_, appended_);
+        std::swap(other.append_buffer_, append_buffer_);
+        std::swap(other.write_buffer_, write_buffer_);
+
+        if (keeps_device) {
+            read_ahead_device_.reset();
+            if (takes_file) {
+                // The file of the other tape is taken over, the chunks are read from it again.
+                device_.reset();
+                other.device_.reset();
+                MoveFile(other.path_, path_);
+                device_ = MakeTapeDevice(path_, format_, storage_);
+                unused_ = true;
+            } else {
+                Create();
+                RewriteFrom(*other.device_);
+                Flush();
+            }
         } else {
             path_ = other.path_;
+            format_ = other.format_;
+            storage_ = other.storage_;
+            device_ = std::move(other.device_);
         }
         other.path_ = "";
-        other.stream_from_.close();
+        other.device_.reset();
+        other.read_ahead_device_.reset();
 
         return *this;
     }
 
     Tape::~Tape() {
-        stream_from_.close();
+        Flush();
+        DropReadAhead();
     }
 
     ChunkSize Tape::CountChunkSize(MemorySize memory, TapeSize size) {
@@ -120,6 +382,22 @@ namespace tape_structure {
         return path_;
     }
 
+    TapeFormat Tape::GetFormat() const {
+        return format_;
+    }
+
+    TapeStorage Tape::GetStorage() const {
+        return storage_;
+    }
+
+    std::chrono::milliseconds Tape::GetSimulatedTime() const {
+        return delays_.GetElapsed();
+    }
+
+    uint64_t Tape::GetShiftCount() const {
+        return delays_.GetShifts();
+    }
+
     TapeSize Tape::GetSize() const {
         return size_;
     }
@@ -136,7 +414,7 @@ namespace tape_structure {
         return chunks_info_.last_size_chunk_;
     }
 
-    std::vector<NumberType> Tape::GetChunkNumbers() const {
+    std::span<const NumberType> Tape::GetChunkNumbers() const {
         return current_chunk_.GetChunkNumbers();
     }
 
@@ -177,85 +455,132 @@ namespace tape_structure {
     }
 
     void Tape::Put(const NumberType& number) {
-        ChunkSize current_pos = current_chunk_.GetPos();
-        ChunksCount current_chunk_number = current_chunk_.GetChunkNumber();
         if (InitFirstChunk()) {
-            current_chunk_.MoveRightPos();
+            current_chunk_.MoveToLeftEdge();
         }
-        std::filesystem::create_directories(kDirForTempTapes_);
 
-        std::filesystem::path tmp_path(kDirForTempTapes_);
-        tmp_path += "print_tmp.txt";
-        std::fstream tmp_to(tmp_path, std::fstream::out);
+        current_chunk_.PutNumberInArrayByPos(number, current_chunk_.GetPos());
+    }
 
-        stream_from_.seekg(0);
-        stream_from_.seekp(0);
+    void Tape::Append(std::span<const NumberType> numbers) {
+        PrepareAppend(numbers.size());
 
-        if (chunks_info_.count_of_chunks_ == 1) {
-            PutNumberInNewChunk(tmp_to, chunks_info_.max_size_chunk_, current_pos, number);
-        } else if (current_chunk_number == chunks_info_.count_of_chunks_ - 1) {
-            for (TapeSize i = 0; i < chunks_info_.count_of_chunks_ - 1; i++) {
-                ReadAndWriteNewChunk(stream_from_, tmp_to, i, chunks_info_.max_size_chunk_);
-            }
-            PutNumberInNewChunk(tmp_to, chunks_info_.last_size_chunk_, current_pos, number);
-        } else if (current_chunk_number == 0) {
-            PutNumberInNewChunk(tmp_to, chunks_info_.max_size_chunk_, current_pos, number);
-            for (TapeSize i = 1; i < chunks_info_.count_of_chunks_ - 1; i++) {
-                ReadAndWriteNewChunk(stream_from_, tmp_to, i, chunks_info_.max_size_chunk_);
-            }
-            ReadAndWriteNewChunk(stream_from_,
-                                 tmp_to,
-                                 chunks_info_.count_of_chunks_ - 1,
-                                 chunks_info_.last_size_chunk_);
-        } else {
-            for (TapeSize i = 0; i < current_chunk_number; i++) {
-                ReadAndWriteNewChunk(stream_from_, tmp_to, i, chunks_info_.max_size_chunk_);
-            }
-            PutNumberInNewChunk(tmp_to, chunks_info_.max_size_chunk_, current_pos, number);
-            for (TapeSize i = current_chunk_number + 1; i < chunks_info_.count_of_chunks_ - 1; i++) {
-                ReadAndWriteNewChunk(stream_from_, tmp_to, i, chunks_info_.max_size_chunk_);
+        while (!numbers.empty()) {
+            ChunksCount chunk_number = appended_ / chunks_info_.max_size_chunk_;
+            ChunkSize chunk_size = GetChunkSize(chunk_number);
+            size_t count = std::min<size_t>(numbers.size(), chunk_size - append_buffer_.GetSize());
+
+            append_buffer_.Reserve(chunk_size);
+            append_buffer_.Append(numbers.first(count));
+            numbers = numbers.subspan(count);
+            appended_ += count;
+
+            if (append_buffer_.GetSize() == chunk_size) {
+                StartWriteBehind(chunk_number);
             }
-            ReadAndWriteNewChunk(stream_from_,
-                                 tmp_to,
-                                 chunks_info_.count_of_chunks_ - 1,
-                                 chunks_info_.last_size_chunk_);
         }
+    }
+
+    void Tape::AppendChunk(std::span<const NumberType> numbers) {
+        ChunksCount chunk_number = appended_ / chunks_info_.max_size_chunk_;
+        if (!append_buffer_.IsEmpty() || numbers.size() != GetChunkSize(chunk_number)) {
+            Append(numbers);
+            return;
+        }
+        PrepareAppend(numbers.size());
+
+        WaitWriteBehind();
+        PassChunk(chunk_number, numbers.size());
+        WriteAppendedChunk(chunk_number, numbers);
+        appended_ += numbers.size();
+    }
+
+    void Tape::Flush() {
+        if (!device_ || !device_->IsOpen()) {
+            return;
+        }
+        WaitWriteBehind();
+        FlushAppended();
+        if (appended_ == size_) {
+            ReleaseAppendBuffers();
+        }
+        if (!unused_) {
+            FlushChunk();
+        }
+        device_->Flush();
+    }
 
-        stream_from_.close();
-        stream_from_.open(path_, std::ios::in | std::ios::out);
-        tmp_to.close();
-        tmp_to.open(tmp_path, std::ios::in);
-        stream_from_.seekg(0);
-        stream_from_.seekp(0);
-        tmp_to.seekg(0);
-        tmp_to.seekp(0);
+    void Tape::Truncate(TapeSize size) {
+        Open();
+        Flush();
+        DropReadAhead();
+        read_ahead_device_.reset();
+        unused_ = true;
+
+        ChunkSize max_size_chunk = chunks_info_.max_size_chunk_;
+        device_->Truncate(size);
+        size_ = size;
+        chunks_info_ = ChunksInfo(max_size_chunk, size_);
+        head_ = std::min(head_, size_);
+        if (appended_ >= size_) {
+            appended_ = size_;
+            ReleaseAppendBuffers();
+        }
+    }
 
-        for (TapeSize i = 0; i < chunks_info_.count_of_chunks_ - 1; i++) {
-            ReadAndWriteNewChunk(tmp_to, stream_from_, i, chunks_info_.max_size_chunk_);
+    void Tape::Close() {
+        if (!device_) {
+            return;
         }
-        ReadAndWriteNewChunk(
-                tmp_to,
-                stream_from_,
-                chunks_info_.count_of_chunks_ - 1,
-                chunks_info_.last_size_chunk_);
+        Flush();
+        DropReadAhead();
+        current_chunk_.Destroy();
+        next_chunk_.Destroy();
+        unused_ = true;
+        read_ahead_device_.reset();
+        // The new device over the same storage is opened when the tape is passed.
+        device_ = device_->Share();
+    }
 
-        tmp_to.close();
-        std::filesystem::remove_all(kDirForTempTapes_);
+    void Tape::AdviseSequential() {
+        if (device_) {
+            device_->AdviseSequential();
+        }
+    }
 
-        while (!current_chunk_.IsMatchWith(current_pos, current_chunk_number)) {
-            MoveRight();
+    void Tape::SetReadAhead(bool read_ahead) {
+        read_ahead_ = read_ahead;
+        if (!read_ahead_) {
+            DropReadAhead();
         }
     }
 
+    void Tape::SetChunkPool(std::shared_ptr<ChunkPool> pool) {
+        WaitWriteBehind();
+        DropReadAhead();
+        current_chunk_.SetPool(pool);
+        next_chunk_.SetPool(pool);
+        append_buffer_ = ChunkBuffer(pool);
+        write_buffer_ = ChunkBuffer(pool);
+        chunk_pool_ = std::move(pool);
+        unused_ = true;
+    }
+
     void Tape::ClearChunkInTape() {
+        Flush();
+        DropReadAhead();
         current_chunk_.Destroy();
     }
 
     bool Tape::InitFirstChunk() {
         if (unused_) {
-            stream_from_.open(path_);
-            current_chunk_.ReadNewChunk(stream_from_, 0, chunks_info_.max_size_chunk_);
+            if (written_.valid() || !append_buffer_.IsEmpty()) {
+                Flush();
+            }
+            Open();
+            ReadChunk(0, chunks_info_.max_size_chunk_);
             unused_ = false;
+            StartReadAhead();
 
             return true;
         }
@@ -267,46 +592,210 @@ namespace tape_structure {
             return;
         }
 
+        FlushChunk();
+
         ChunksCount current_chunk_number = current_chunk_.GetChunkNumber();
-        current_chunk_.ReadNewChunk(stream_from_,
-                                    current_chunk_number + 1,
-                                    current_chunk_number + 1 == chunks_info_.count_of_chunks_ - 1
-                                            ? chunks_info_.last_size_chunk_
-                                            : chunks_info_.max_size_chunk_);
-        current_chunk_.MoveToLeftEdge();
+        if (TakeReadAhead(current_chunk_number + 1)) {
+            PassChunk(current_chunk_number + 1, GetChunkSize(current_chunk_number + 1));
+        } else {
+            ReadChunk(current_chunk_number + 1, GetChunkSize(current_chunk_number + 1));
+            current_chunk_.MoveToLeftEdge();
+        }
+        StartReadAhead();
     }
 
     void Tape::ReadChunkToTheLeft() {
-        stream_from_.seekp(0);
-        stream_from_.seekg(0);
+        FlushChunk();
 
         ChunksCount current_chunk_number = current_chunk_.GetChunkNumber();
+        if (TakeReadAhead(current_chunk_number - 1)) {
+            PassChunk(current_chunk_number - 1, chunks_info_.max_size_chunk_, true);
+        } else {
+            ReadChunk(current_chunk_number - 1, chunks_info_.max_size_chunk_, true);
+            current_chunk_.MoveToRightEdge();
+        }
+        StartReadAhead();
+    }
 
-        for (ChunkSize i = 0; i < (current_chunk_number - 1) * chunks_info_.max_size_chunk_; i++) {
-            NumberType number;
-            stream_from_ >> number;
+    void Tape::ReadLastChunk() {
+        if (unused_) {
+            if (written_.valid() || !append_buffer_.IsEmpty()) {
+                Flush();
+            }
+            Open();
+            unused_ = false;
+        } else {
+            FlushChunk();
         }
+        DropReadAhead();
 
-        current_chunk_.ReadNewChunk(stream_from_,
-                                    current_chunk_number - 1,
-                                    chunks_info_.max_size_chunk_);
+        ChunksCount chunk_number = chunks_info_.count_of_chunks_ - 1;
+        ReadChunk(chunk_number, GetChunkSize(chunk_number), true);
         current_chunk_.MoveToRightEdge();
+        StartReadAhead();
+    }
+
+    void Tape::Open() {
+        if (!device_->IsOpen()) {
+            device_->Open(size_, chunks_info_.max_size_chunk_);
+        }
     }
 
-    void Tape::PutNumberInNewChunk(std::fstream& to, ChunkSize size, ChunkSize pos, NumberType number) {
-        current_chunk_.ReadNewChunk(stream_from_,
-                                    current_chunk_.GetChunkNumber(),
-                                    size);
-        current_chunk_.PutNumberInArrayByPos(number, pos);
-        current_chunk_.PrintChunk(to);
+    void Tape::Create() {
+        DropReadAhead();
+        read_ahead_device_.reset();
+        WaitWriteBehind();
+        appended_ = 0;
+        append_buffer_.Clear();
+        device_->Create(size_, chunks_info_.max_size_chunk_);
+        unused_ = true;
+        head_ = 0;
+        to_the_left_ = false;
     }
 
-    void Tape::ReadAndWriteNewChunk(std::fstream& from,
-                                    std::fstream& to,
-                                    ChunksCount new_chunk_number,
-                                    ChunkSize new_size) {
-        current_chunk_.ReadNewChunk(from, new_chunk_number, new_size);
-        current_chunk_.PrintChunk(to);
+    void Tape::RewriteFrom(TapeDevice& from) {
+        ChunkBuffer chunk(chunk_pool_);
+        for (ChunksCount i = 0; i < chunks_info_.count_of_chunks_; i++) {
+            chunk.Resize(GetChunkSize(i));
+            from.ReadChunk(i, chunk.GetNumbers());
+            device_->WriteChunk(i, chunk.GetNumbers());
+        }
+    }
+
+    void Tape::ReadChunk(ChunksCount chunk_number, ChunkSize size, bool to_the_left) {
+        PassChunk(chunk_number, size, to_the_left);
+        current_chunk_.ReadNewChunk(*device_, chunk_number, size);
+    }
+
+    void Tape::PassChunk(ChunksCount chunk_number, ChunkSize size, bool to_the_left) {
+        TapeSize begin = chunk_number * chunks_info_.max_size_chunk_;
+        TapeSize from = to_the_left ? begin + size : begin;
+        delays_.Shift(from > head_ ? from - head_ : head_ - from);
+        head_ = to_the_left ? begin : begin + size;
+        to_the_left_ = to_the_left;
+    }
+
+    ChunkSize Tape::GetChunkSize(ChunksCount chunk_number) const {
+        return chunk_number == chunks_info_.count_of_chunks_ - 1
+                       ? chunks_info_.last_size_chunk_
+                       : chunks_info_.max_size_chunk_;
+    }
+
+    void Tape::FlushChunk() {
+        if (current_chunk_.IsDirty()) {
+            DropReadAhead();
+            if (format_ != TapeFormat::kBinary) {
+                // The chunk may change its length and shift the next ones, so the offsets the read-ahead device
+                // has found are stale. A text tape finds them again by parsing it from the beginning,
+                // so it is not read ahead after it is changed.
+                read_ahead_device_.reset();
+                read_ahead_ = read_ahead_ && format_ != TapeFormat::kText;
+            }
+            current_chunk_.PrintChunk(*device_);
+        }
+    }
+
+    void Tape::PrepareAppend(size_t count) {
+        if (count > size_ - appended_) {
+            throw std::out_of_range("Appended numbers do not fit in the tape");
+        }
+        if (!unused_) {
+            FlushChunk();
+            unused_ = true;
+        }
+        DropReadAhead();
+        read_ahead_device_.reset();
+        Open();
+    }
+
+    void Tape::StartWriteBehind(ChunksCount chunk_number) {
+        WaitWriteBehind();
+        std::swap(append_buffer_, write_buffer_);
+        append_buffer_.Clear();
+        PassChunk(chunk_number, write_buffer_.GetSize());
+
+        written_ = std::async(std::launch::async, [this, chunk_number]() {
+            WriteAppendedChunk(chunk_number, write_buffer_.GetNumbers());
+        });
+    }
+
+    void Tape::WriteAppendedChunk(ChunksCount chunk_number, std::span<const NumberType> numbers) {
+        delays_.Wait(delays_.delay_for_put_, numbers.size());
+        delays_.Shift(numbers.size());
+        device_->WriteChunk(chunk_number, numbers);
+    }
+
+    void Tape::WaitWriteBehind() {
+        if (written_.valid()) {
+            written_.get();
+        }
+    }
+
+    void Tape::ReleaseAppendBuffers() {
+        append_buffer_.Release();
+        write_buffer_.Release();
+    }
+
+    void Tape::FlushAppended() {
+        if (append_buffer_.IsEmpty()) {
+            return;
+        }
+        ChunksCount chunk_number = appended_ / chunks_info_.max_size_chunk_;
+        PassChunk(chunk_number, append_buffer_.GetSize());
+        delays_.Wait(delays_.delay_for_put_, append_buffer_.GetSize());
+        delays_.Shift(append_buffer_.GetSize());
+        ChunkBuffer chunk(chunk_pool_);
+        chunk.Resize(GetChunkSize(chunk_number));
+        device_->ReadChunk(chunk_number, chunk.GetNumbers());
+        std::ranges::copy(append_buffer_.GetNumbers(), chunk.GetData());
+        device_->WriteChunk(chunk_number, chunk.GetNumbers());
+    }
+
+    void Tape::StartReadAhead() {
+        ChunksCount current_chunk_number = current_chunk_.GetChunkNumber();
+        if (!read_ahead_ || (to_the_left_ ? current_chunk_number == 0
+                                          : current_chunk_number + 1 >= chunks_info_.count_of_chunks_)) {
+            return;
+        }
+        ChunksCount chunk_number = to_the_left_ ? current_chunk_number - 1 : current_chunk_number + 1;
+        DropReadAhead();
+
+        // The read-ahead device reads the file by itself, so it should see the chunks written before.
+        device_->Flush();
+        if (!read_ahead_device_) {
+            read_ahead_device_ = device_->Share();
+            read_ahead_device_->Open(size_, chunks_info_.max_size_chunk_);
+            next_chunk_ = Chunk(delays_, 0, 0);
+            next_chunk_.SetPool(chunk_pool_);
+        }
+        ChunkSize size = GetChunkSize(chunk_number);
+        next_chunk_ready_ = std::async(std::launch::async, [this, chunk_number, size, to_the_left = to_the_left_]() {
+            next_chunk_.ReadNewChunk(*read_ahead_device_, chunk_number, size);
+            if (to_the_left) {
+                next_chunk_.MoveToRightEdge();
+            } else {
+                next_chunk_.MoveToLeftEdge();
+            }
+        });
+    }
+
+    bool Tape::TakeReadAhead(ChunksCount chunk_number) {
+        if (!next_chunk_ready_.valid()) {
+            return false;
+        }
+        next_chunk_ready_.get();
+        if (next_chunk_.GetChunkNumber() != chunk_number) {
+            return false;
+        }
+        std::swap(current_chunk_, next_chunk_);
+        return true;
+    }
+
+    void Tape::DropReadAhead() {
+        if (next_chunk_ready_.valid()) {
+            next_chunk_ready_.wait();
+            next_chunk_ready_ = {};
+        }
     }
 
     Tape::ChunksInfo::ChunksInfo::ChunksInfo(ChunkSize chunk_size, TapeSize tape_size) {
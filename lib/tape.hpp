@@ -2,13 +2,17 @@
 
 #include <filesystem>
 #include <fstream>
+#include <future>
+#include <memory>
+#include <span>
+#include <stdexcept>
 #include <vector>
 
 #include "chunk/chunk.hpp"
+#include "device/tape_device.hpp"
 
 namespace tape_structure {
-    using TapeSize = ChunksCount;
-    using MemorySize = uint32_t;
+    using MemorySize = uint64_t;
 
     /**
      * Tape can move to the right or to the left while the magnetic head is stationary.
@@ -26,22 +30,60 @@ namespace tape_structure {
         Tape(std::filesystem::path &path,
              std::chrono::milliseconds delay_for_read,
              std::chrono::milliseconds delay_for_put,
-             std::chrono::milliseconds delay_for_shift);
-        Tape(std::filesystem::path &path, Delays delays);
+             std::chrono::milliseconds delay_for_shift,
+             TapeFormat format = TapeFormat::kText,
+             TapeStorage storage = TapeStorage::kStream);
+        Tape(std::filesystem::path &path,
+             Delays delays,
+             TapeFormat format = TapeFormat::kText,
+             TapeStorage storage = TapeStorage::kStream);
         Tape(std::filesystem::path &path,
              TapeSize tape_size,
              ChunkSize chunk_size,
              std::chrono::milliseconds delay_for_read,
              std::chrono::milliseconds delay_for_put,
-             std::chrono::milliseconds delay_for_shift);
-        Tape(std::filesystem::path &path, TapeSize tape_size, ChunkSize chunk_size);
+             std::chrono::milliseconds delay_for_shift,
+             TapeFormat format = TapeFormat::kText,
+             TapeStorage storage = TapeStorage::kStream);
+        Tape(std::filesystem::path &path,
+             TapeSize tape_size,
+             ChunkSize chunk_size,
+             Delays delays,
+             TapeFormat format = TapeFormat::kText,
+             TapeStorage storage = TapeStorage::kStream);
+        Tape(std::filesystem::path &path,
+             TapeSize tape_size,
+             ChunkSize chunk_size,
+             TapeFormat format = TapeFormat::kText,
+             TapeStorage storage = TapeStorage::kStream);
+        Tape(std::unique_ptr<TapeDevice> device,
+             TapeSize tape_size,
+             ChunkSize chunk_size,
+             Delays delays = Delays());
 
         Tape(const Tape &);
-        Tape(const Tape &, std::filesystem::path &path);
+        /**
+         * Copy the tape to another file.
+         * The tape is flushed first, so that the numbers it has not written yet are copied too.
+         * The file of a tape stored in a file is copied by the kernel (a reflink or copy_file_range).
+         *
+         * @param path path to the file of the copy
+         */
+        Tape(Tape &, std::filesystem::path &path);
         Tape &operator=(const Tape &);
 
+        /**
+         * Take the tape over as it is, its numbers which are not written yet are written by this tape.
+         * The reading ahead and the writing behind of the moved tape are waited for, nothing else is done.
+         */
         Tape(Tape &&) noexcept;
-        Tape &operator=(Tape &&) noexcept;
+        /**
+         * Move the tape into this one.
+         * If this tape has a device with another file, the file of the moved tape is renamed to it
+         * (if both files are of the same format), otherwise the numbers are rewritten to it.
+         * Throws if the files can not be written.
+         */
+        Tape &operator=(Tape &&);
 
         ~Tape();
 
@@ -54,12 +96,58 @@ namespace tape_structure {
          */
         static ChunkSize CountChunkSize(MemorySize memory, TapeSize size);
 
+        /**
+         * Convert the tape file from one format to another.
+         * It is used to import text tapes into the binary format and to export them back.
+         *
+         * @param from path to the source tape file
+         * @param from_format format of the source tape file
+         * @param to path to the resulting tape file
+         * @param to_format format of the resulting tape file
+         */
+        static void Convert(const std::filesystem::path &from, TapeFormat from_format,
+                            const std::filesystem::path &to, TapeFormat to_format);
+        /**
+         * Move the file, copying it only if it can not be renamed (e.g. to another file system).
+         *
+         * @param from path to the source file, it is removed
+         * @param to new path to the file, it is overwritten
+         */
+        static void MoveFile(const std::filesystem::path &from, const std::filesystem::path &to);
+
         /**
          * Get the path to the file where the tape is located.
+         * It is empty for tapes created over a custom device.
          *
          * @return path to the file where the tape is located
          */
         [[nodiscard]] std::filesystem::path GetPath() const;
+        /**
+         * Get the format of the file where the tape is located.
+         *
+         * @return format of the tape file
+         */
+        [[nodiscard]] TapeFormat GetFormat() const;
+        /**
+         * Get the way the tape is stored.
+         *
+         * @return storage of the tape
+         */
+        [[nodiscard]] TapeStorage GetStorage() const;
+        /**
+         * Get the simulated time of the operations of the tape with its delays.
+         *
+         * @return simulated time
+         */
+        [[nodiscard]] std::chrono::milliseconds GetSimulatedTime() const;
+        /**
+         * Get the count of the positions the tape has moved by (counted if the delay for shift is set).
+         * Moving the head to the position where the device is read or written from
+         * (e.g. rewinding the tape to the beginning after it is written) counts too.
+         *
+         * @return count of the positions
+         */
+        [[nodiscard]] uint64_t GetShiftCount() const;
         /**
          * Get the size of tape.
          *
@@ -86,11 +174,11 @@ namespace tape_structure {
          */
         [[nodiscard]] ChunkSize GetMinChunkSize() const;
         /**
-         * Get the number of chunks in the tape.
+         * Get the numbers of the current chunk.
          *
-         * @return number of chunks in the tape
+         * @return view of the numbers, valid until another chunk is read
          */
-        [[nodiscard]] std::vector<NumberType> GetChunkNumbers() const;
+        [[nodiscard]] std::span<const NumberType> GetChunkNumbers() const;
         /**
          * Get the number indicated by the magnetic head.
          *
@@ -115,10 +203,76 @@ namespace tape_structure {
 
         /**
          * Put a new element in the tape.
+         * Only the current chunk is changed, it is written to the device
+         * when the tape moves to another chunk or is flushed.
          *
          * @param number new element.
          */
         void Put(const NumberType &number);
+        /**
+         * Append numbers after the ones appended before (the first numbers are appended at the beginning).
+         * Every completed chunk is written to the device in the background
+         * while the next one is being appended, so the caller does not wait for the device
+         * (and the delays in putting and shifting).
+         * The magnetic head returns to the beginning of the tape.
+         * Throws std::out_of_range if the numbers do not fit in the tape.
+         *
+         * @param numbers new elements
+         */
+        void Append(std::span<const NumberType> numbers);
+        /**
+         * Append the numbers of the whole next chunk, they are written to the device right away
+         * from the memory of the caller without copying them to the append buffer.
+         * Falls back to Append if a chunk is partly appended or the numbers are not the whole chunk.
+         * The magnetic head returns to the beginning of the tape.
+         * Throws std::out_of_range if the numbers do not fit in the tape.
+         *
+         * @param numbers new elements
+         */
+        void AppendChunk(std::span<const NumberType> numbers);
+        /**
+         * Write the changed current chunk and the appended numbers to the device.
+         */
+        void Flush();
+        /**
+         * Cut the tape, the numbers after the first `size` ones are discarded.
+         * It is used when the size of the tape is not known in advance:
+         * the tape is created with an upper bound of the size and cut after the numbers are appended.
+         * The magnetic head returns to the beginning of the tape.
+         *
+         * @param size new size of the tape, it is positive and not greater than the current one
+         */
+        void Truncate(TapeSize size);
+        /**
+         * Release the memory of the tape until it is passed again: the chunks and the buffers of the device,
+         * which is closed. The numbers stay in the storage, the head stays in place.
+         * The buffers of the appended numbers are released by Flush once the tape is full.
+         */
+        void Close();
+
+        /**
+         * Hint that the tape will be passed sequentially (e.g. during a merge pass).
+         * It only has an effect on devices which support it (memory-mapped tapes).
+         */
+        void AdviseSequential();
+        /**
+         * Turn on or off reading ahead.
+         * While the current chunk is being passed, the chunk to the right of it is read in the background,
+         * so moving to it does not wait for the device (and the delays in shifting and reading).
+         * It pays off for tapes that are passed from left to right without putting, e.g. during a merge pass.
+         * A text tape stops reading ahead when a put number is flushed, since its chunks may shift then.
+         *
+         * @param read_ahead true to read ahead else false
+         */
+        void SetReadAhead(bool read_ahead);
+        /**
+         * Take the buffers of the chunks and of the appended numbers from a pool,
+         * so the tapes created one after another reuse the memory of each other.
+         * It should be called before the tape is passed or appended to.
+         *
+         * @param pool pool of chunk buffers (nullptr - the buffers are allocated by the tape)
+         */
+        void SetChunkPool(std::shared_ptr<ChunkPool> pool);
 
         /**
          * Clear current chunk.
@@ -169,36 +323,115 @@ namespace tape_structure {
          * Read the chunk to the left of the current one.
          */
         void ReadChunkToTheLeft();
+        /**
+         * Read the last chunk of the tape, so the tape can be passed from the end to the beginning
+         * with ReadChunkToTheLeft. The magnetic head is at the right edge of the chunk.
+         */
+        void ReadLastChunk();
 
+        /**
+         * Open the device of the tape if it is not open yet.
+         */
+        void Open();
+        /**
+         * Discard the content of the tape and create an empty one in its device.
+         */
+        void Create();
+        /**
+         * Rewrite the tape from another device chunk by chunk.
+         *
+         * @param from open device with a tape of the same size and chunks
+         */
+        void RewriteFrom(TapeDevice &from);
         /**
          * Rewrite tape from one file to another.
          *
          * @param from file stream from where the tape is being read
+         * @param from_format format of the file from where the tape is being read
          * @param to file stream where the tape is recorded
+         * @param to_format format of the file where the tape is recorded
          */
-        static void RewriteFromTo(std::fstream &from, std::fstream &to);
+        static void RewriteFromTo(std::fstream &from, TapeFormat from_format,
+                                  std::fstream &to, TapeFormat to_format);
 
         /**
-         * Put a new number in the current chunk.
+         * Read the chunk from the device.
+         *
+         * @param chunk_number number of the chunk
+         * @param size size of the chunk
+         * @param to_the_left the chunk is passed from its right edge to the left one
+         */
+        void ReadChunk(ChunksCount chunk_number, ChunkSize size, bool to_the_left = false);
+        /**
+         * Move the head of the device to the edge of the chunk it is going to pass, spending the delays for shift,
+         * and then to the other edge of the chunk (the pass itself is spent by the one reading or writing the chunk).
+         *
+         * @param chunk_number number of the chunk
+         * @param size count of the numbers of the chunk which are passed
+         * @param to_the_left the chunk is passed from its right edge to the left one
+         */
+        void PassChunk(ChunksCount chunk_number, ChunkSize size, bool to_the_left = false);
+        /**
+         * Get the size of the chunk by its number.
          *
-         * @param to file stream where the chunk with the new number will be placed
-         * @param size size for the new chunk
-         * @param pos position to put the new number on
-         * @param number number to put
+         * @param chunk_number number of the chunk
+         * @return size of the chunk
          */
-        void PutNumberInNewChunk(std::fstream &to, ChunkSize size, ChunkSize pos, NumberType number);
+        [[nodiscard]] ChunkSize GetChunkSize(ChunksCount chunk_number) const;
+        /**
+         * Write the current chunk to the device if it has been changed.
+         */
+        void FlushChunk();
 
         /**
-         * Read and write new chunk.
+         * Check that the appended numbers fit in the tape and prepare the tape for appending.
+         *
+         * @param count count of the appended numbers
+         */
+        void PrepareAppend(size_t count);
+        /**
+         * Start writing the completed chunk of the appended numbers in the background.
+         *
+         * @param chunk_number number of the completed chunk
+         */
+        void StartWriteBehind(ChunksCount chunk_number);
+        /**
+         * Wait for the background writing.
+         */
+        void WaitWriteBehind();
+        /**
+         * Write a completed chunk of the appended numbers to the device with the delays in putting and shifting.
+         *
+         * @param chunk_number number of the chunk
+         * @param numbers numbers of the chunk
+         */
+        void WriteAppendedChunk(ChunksCount chunk_number, std::span<const NumberType> numbers);
+        /**
+         * Write the appended numbers of the incomplete chunk, the rest of the chunk is not changed.
+         */
+        void FlushAppended();
+        /**
+         * Free the buffers of the appended numbers when nothing more can be appended,
+         * so the tape does not keep them in memory after it is written.
+         */
+        void ReleaseAppendBuffers();
+
+        /**
+         * Start reading the next chunk in the background: the chunk to the right of the current one,
+         * or the one to the left of it if the tape is passed from the end.
+         */
+        void StartReadAhead();
+        /**
+         * Make the chunk read ahead the current one.
          *
-         * @param from file stream from where the chunk is read
-         * @param to file stream where the chunk is written
-         * @param new_chunk_number number of new chunk
-         * @param new_size size of new chunk
+         * @param chunk_number number of the chunk which is needed
+         * @return true if the chunk has been read ahead else false
+         */
+        bool TakeReadAhead(ChunksCount chunk_number);
+        /**
+         * Wait for the background reading and forget the chunk read ahead.
          */
-        void ReadAndWriteNewChunk(std::fstream &from, std::fstream &to,
-                                  ChunksCount new_chunk_number,
-                                  ChunkSize new_size);
+        void DropReadAhead();
 
         /**
          * Delays in reading, putting and shifting.
@@ -210,14 +443,32 @@ namespace tape_structure {
          */
         std::filesystem::path path_;
         /**
-         * File stream from where the tape is read.
+         * Format of the file where the tape is located.
+         */
+        TapeFormat format_ = TapeFormat::kText;
+        /**
+         * Way the tape is stored.
+         */
+        TapeStorage storage_ = TapeStorage::kStream;
+        /**
+         * Device where the tape is stored.
+         * Tapes created without a path have no device until another tape is moved into them.
          */
-        std::fstream stream_from_;
+        std::unique_ptr<TapeDevice> device_;
 
         /**
          * Number  of elements (numbers) of the tape.
          */
         TapeSize size_{};
+        /**
+         * Position of the head of the device, where the last chunk read or written from the device ends.
+         * Reading or writing a chunk elsewhere moves the tape to it first.
+         */
+        TapeSize head_{};
+        /**
+         * The last chunk was read from its right edge to the left one.
+         */
+        bool to_the_left_ = false;
 
         /**
          * Information about chunks.
@@ -234,8 +485,48 @@ namespace tape_structure {
          */
         bool unused_ = true;
 
-        static const NumberType kDivider = 16;
-        const std::filesystem::path kDirForTempTapes_ = "./kDirForTempTapes_/";
+        /**
+         * Reading ahead is turned on.
+         */
+        bool read_ahead_ = false;
+        /**
+         * Device over the same storage used to read ahead, so the background reading does not
+         * interfere with the device of the tape. It is recreated after the tape is written.
+         */
+        std::unique_ptr<TapeDevice> read_ahead_device_;
+        /**
+         * Pool of the buffers of the chunks and of the appended numbers, nullptr if the tape allocates them.
+         */
+        std::shared_ptr<ChunkPool> chunk_pool_;
+        /**
+         * Second chunk buffer, the chunk to the right of the current one is read into it.
+         * It is swapped with the current chunk, so the buffers are reused.
+         */
+        Chunk next_chunk_;
+        /**
+         * Result of the background reading of next_chunk_.
+         */
+        std::future<void> next_chunk_ready_;
+
+        /**
+         * Count of the numbers appended since the tape was created.
+         */
+        TapeSize appended_{};
+        /**
+         * Appended numbers of the chunk which is not completed yet.
+         */
+        ChunkBuffer append_buffer_;
+        /**
+         * Second buffer for the appended numbers, the completed chunk is written from it.
+         * It is swapped with append_buffer_, so the buffers are reused.
+         */
+        ChunkBuffer write_buffer_;
+        /**
+         * Result of the background writing of write_buffer_.
+         */
+        std::future<void> written_;
+
+        static constexpr MemorySize kDivider = 16;
     };
 
 } // namespace tape_structure
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "lib/sorter/tape_sorter.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <sstream>
+
+// The tests are built for every type of the numbers on the tapes, NumberType is the type of the linked library.
+using tape_structure::NumberType;
+
+/**
+ * Make random numbers of the whole range of the type, with its extremes and with ties.
+ *
+ * @param size count of numbers
+ * @param seed seed of the random numbers
+ * @return numbers
+ */
+std::vector<NumberType> MakeNumbers(size_t size, uint64_t seed) {
+    std::mt19937_64 random(seed);
+    std::uniform_real_distribution<double> real_distribution(-1e9, 1e9);
+    std::vector<NumberType> numbers(size);
+    for (NumberType &number: numbers) {
+        if constexpr (std::is_integral_v<NumberType>) {
+            number = static_cast<NumberType>(random());
+        } else {
+            number = static_cast<NumberType>(real_distribution(random));
+        }
+    }
+    numbers[0] = std::numeric_limits<NumberType>::lowest();
+    numbers[1] = std::numeric_limits<NumberType>::max();
+    numbers[2] = std::numeric_limits<NumberType>::min();
+    for (size_t i = 3; i < size; i += 7) {
+        numbers[i] = numbers[i - 3];
+    }
+    return numbers;
+}
+
+/**
+ * Read all the numbers of a text file.
+ *
+ * @param path path to the file
+ * @param size count of numbers
+ * @return numbers
+ */
+std::vector<NumberType> ReadText(const std::filesystem::path &path, size_t size) {
+    std::ifstream fin(path);
+    tape_structure::text_format::TextReader reader(fin);
+    std::vector<NumberType> numbers(size);
+    EXPECT_EQ(reader.ReadNumbers(numbers.data(), numbers.size()), size);
+    return numbers;
+}
+
+TEST(NumberType, TestBinaryTape) {
+    std::filesystem::path path = "./utests/number_type.tape";
+    const std::vector<NumberType> kNumbers = MakeNumbers(1000, 1);
+
+    {
+        tape_structure::Tape tape(path, kNumbers.size(), 64, tape_structure::TapeFormat::kBinary);
+        tape.Append(kNumbers);
+    }
+    EXPECT_EQ(std::filesystem::file_size(path),
+              tape_structure::binary_format::OffsetOf(kNumbers.size(), sizeof(NumberType)));
+
+    tape_structure::Tape tape(path, kNumbers.size(), 64, tape_structure::TapeFormat::kBinary);
+    std::vector<NumberType> numbers = {tape.GetCurrentNumber()};
+    while (tape.MoveLeft()) {
+        numbers.push_back(tape.GetCurrentNumber());
+    }
+    EXPECT_EQ(numbers, kNumbers);
+}
+
+TEST(NumberType, TestSort) {
+    using tape_structure::SplitStrategy;
+    using tape_structure::TapeFormat;
+    using tape_structure::TapeStorage;
+
+    std::filesystem::path path_in = "./utests/number_type.in";
+    std::filesystem::path path_out = "./utests/number_type.out";
+
+    const tape_structure::TapeSize kSize = 20000;
+    const tape_structure::MemorySize kMemory = 40960;
+
+    std::vector<NumberType> numbers = MakeNumbers(kSize, 2);
+    {
+        std::string text;
+        tape_structure::text_format::AppendNumbers(text, numbers.data(), numbers.size());
+        std::ofstream(path_in) << text;
+    }
+    std::sort(numbers.begin(), numbers.end());
+
+    for (tape_structure::SortOptions options: std::vector<tape_structure::SortOptions>{
+                 {},
+                 {.tmp_format_ = TapeFormat::kCompressed, .read_ahead_ = true},
+                 {.tmp_storage_ = TapeStorage::kMmap, .split_strategy_ = SplitStrategy::kReplacementSelection},
+                 {.tmp_storage_ = TapeStorage::kMemory, .split_strategy_ = SplitStrategy::kNaturalRuns},
+                 {.workers_ = 4, .alternate_directions_ = true},
+                 {.polyphase_tapes_ = 4}}) {
+        options.tmp_dir_ = "./tmp/sort";
+        tape_structure::Tape tape_in(path_in, kSize, tape_structure::Tape::CountChunkSize(kMemory, kSize));
+        tape_structure::Tape tape_out(path_out, tape_structure::Delays());
+        tape_structure::TapeSorter sorter(tape_in, tape_out, options);
+        sorter.Sort();
+
+        EXPECT_EQ(ReadText(path_out, kSize), numbers);
+    }
+}
+
+TEST(NumberType, TestSortBinary) {
+    std::filesystem::path path_in = "./utests/number_type_in.tape";
+    std::filesystem::path path_out = "./utests/number_type_out.tape";
+
+    const tape_structure::TapeSize kSize = 20000;
+    const tape_structure::MemorySize kMemory = 40960;
+
+    std::vector<NumberType> numbers = MakeNumbers(kSize, 3);
+    {
+        tape_structure::Tape tape(path_in, kSize, 1024, tape_structure::TapeFormat::kBinary);
+        tape.Append(numbers);
+    }
+    std::sort(numbers.begin(), numbers.end());
+
+    {
+        tape_structure::Tape tape_in(path_in, kSize, tape_structure::Tape::CountChunkSize(kMemory, kSize),
+                                     tape_structure::Delays(), tape_structure::TapeFormat::kBinary);
+        tape_structure::Tape tape_out(path_out, tape_structure::Delays(), tape_structure::TapeFormat::kBinary);
+        tape_structure::TapeSorter sorter(tape_in, tape_out, {.read_ahead_ = true, .tmp_dir_ = "./tmp/sort_binary"});
+        sorter.Sort();
+    }
+
+    tape_structure::Tape tape(path_out, kSize, 1024, tape_structure::TapeFormat::kBinary);
+    std::vector<NumberType> result = {tape.GetCurrentNumber()};
+    while (tape.MoveLeft()) {
+        result.push_back(tape.GetCurrentNumber());
+    }
+    EXPECT_EQ(result, numbers);
+}
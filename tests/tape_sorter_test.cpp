@@ -2,7 +2,88 @@
 
 #include <gtest/gtest.h>
 
+#include <limits>
+#include <numeric>
+#include <random>
+
 #include "lib/config_reader/simple_yaml_reader.hpp"
+#include "lib/device/memory_device.hpp"
+#include "lib/device/reversed_device.hpp"
+
+using namespace std::chrono_literals;
+
+/**
+ * Get the directory of the temporary tapes of the running test, so the tests running at once do not share it.
+ *
+ * @return path to the directory
+ */
+std::filesystem::path TmpDir() {
+    return std::filesystem::path("./tmp") / ::testing::UnitTest::GetInstance()->current_test_info()->name();
+}
+
+/**
+ * Write the numbers to a text tape.
+ *
+ * @param path path to the tape
+ * @param numbers numbers of the tape
+ */
+void WriteTextTape(const std::filesystem::path &path, const std::vector<int32_t> &numbers) {
+    std::ofstream fout(path);
+    for (int32_t number: numbers) {
+        fout << number << ' ';
+    }
+}
+
+/**
+ * Write uniformly distributed random numbers to a text tape.
+ *
+ * @param path path to the tape
+ * @param size count of numbers
+ * @param seed seed of the random numbers
+ * @param min least number
+ * @param max greatest number
+ * @return numbers of the tape
+ */
+std::vector<int32_t> WriteRandomTape(const std::filesystem::path &path,
+                                     size_t size,
+                                     uint32_t seed,
+                                     int32_t min,
+                                     int32_t max) {
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int32_t> distribution(min, max);
+    std::vector<int32_t> numbers(size);
+    for (int32_t &number: numbers) {
+        number = distribution(random);
+    }
+    WriteTextTape(path, numbers);
+    return numbers;
+}
+
+/**
+ * Read all the numbers of a text tape.
+ *
+ * @param path path to the tape
+ * @return numbers of the tape
+ */
+std::vector<int32_t> ReadTextTape(const std::filesystem::path &path) {
+    std::ifstream fin(path);
+    std::vector<int32_t> numbers;
+    for (int32_t number; fin >> number;) {
+        numbers.push_back(number);
+    }
+    return numbers;
+}
+
+/**
+ * Expect a text tape to hold the given numbers in ascending order.
+ *
+ * @param path path to the tape
+ * @param numbers numbers in any order
+ */
+void ExpectSorted(const std::filesystem::path &path, std::vector<int32_t> numbers) {
+    std::sort(numbers.begin(), numbers.end());
+    EXPECT_EQ(ReadTextTape(path), numbers) << path;
+}
 
 TEST(TapeStructure, TestResultFile1) {
     std::filesystem::path path = "./resources/config1.yaml";
@@ -32,7 +113,7 @@ TEST(TapeStructure, TestResultFile1) {
                                   delay_for_put,
                                   delay_for_shift);
 
-    tape_structure::TapeSorter sorter(tape_in, tape_out);
+    tape_structure::TapeSorter sorter(tape_in, tape_out, {.tmp_dir_ = TmpDir()});
 
     sorter.Sort();
 
@@ -73,7 +154,7 @@ TEST(TapeStructure, TestResultFile2) {
                                   delay_for_read,
                                   delay_for_put,
                                   delay_for_shift);
-    tape_structure::TapeSorter sorter(tape_in, tape_out);
+    tape_structure::TapeSorter sorter(tape_in, tape_out, {.tmp_dir_ = TmpDir()});
 
     sorter.Sort();
 
@@ -114,10 +195,648 @@ TEST(TapeStructure, TestResultFile3) {
                                   delay_for_read,
                                   delay_for_put,
                                   delay_for_shift);
-    tape_structure::TapeSorter sorter(tape_in, tape_out);
+    tape_structure::TapeSorter sorter(tape_in, tape_out, {.tmp_dir_ = TmpDir()});
+
+    sorter.Sort();
+
+    std::ifstream fin(path_out);
+
+    std::string result;
+    std::getline(fin, result);
+
+    const std::string kExpected =
+            "-21435246 -6374869 -675162 -76854 -48130 -9876"
+            " -6254 0 6 865 34578 56342 84613 87645 235646"
+            " 314526 358128 3481364 5343127 5463276 7231462"
+            " 8125637 8745637 56142738 61432576 659298456 ";
+    EXPECT_EQ(result, kExpected);
+}
+
+TEST(TapeStructure, TestBinaryFormat) {
+    std::filesystem::path path_text_in = "./resources/input1.in";
+    std::filesystem::path path_in = "./resources/input1.tape";
+    std::filesystem::path path_out = "./utests/output_binary.tape";
+    std::filesystem::path path_text_out = "./utests/output_binary.out";
+
+    tape_structure::Tape::Convert(path_text_in, tape_structure::TapeFormat::kText,
+                                  path_in, tape_structure::TapeFormat::kBinary);
+    EXPECT_EQ(std::filesystem::file_size(path_in), tape_structure::binary_format::OffsetOf(20, sizeof(int32_t)));
+
+    std::fstream(path_out, std::fstream::out);
+    tape_structure::Tape tape_in(path_in, 20, tape_structure::Tape::CountChunkSize(65, 20),
+                                 tape_structure::TapeFormat::kBinary);
+    tape_structure::Tape tape_out(path_out, tape_structure::Delays(), tape_structure::TapeFormat::kBinary);
+
+    tape_structure::TapeSorter sorter(tape_in, tape_out, {.tmp_dir_ = TmpDir()});
+
+    sorter.Sort();
+
+    tape_structure::Tape::Convert(path_out, tape_structure::TapeFormat::kBinary,
+                                  path_text_out, tape_structure::TapeFormat::kText);
+
+    std::ifstream fin(path_text_out);
+
+    std::string result;
+    std::getline(fin, result);
+
+    const std::string kExpected = "5 5 11 22 22 33 44 54 55 66 77 88 92 99 111 122 144 148 155 12345 ";
+    EXPECT_EQ(result, kExpected);
+}
+
+TEST(TapeStructure, TestPutInPlace) {
+    std::filesystem::path path = "./utests/put_in_place.txt";
+    std::ofstream(path) << "1 2 3 4 5 6 7 8 9 10";
+
+    {
+        tape_structure::Tape tape(path, 10, 3);
+        for (int i = 0; i < 4; i++) {
+            tape.MoveLeft();
+        }
+        tape.Put(12345);
+        while (tape.MoveLeft()) {}
+        tape.Put(-1);
+        while (tape.MoveRight()) {}
+        tape.Put(0);
+        EXPECT_EQ(tape.GetCurrentNumber(), 0);
+    }
+
+    std::ifstream fin(path);
+
+    std::string result;
+    std::getline(fin, result);
+
+    const std::string kExpected = "0 2 3 4 12345 6 7 8 9 -1 ";
+    EXPECT_EQ(result, kExpected);
+}
+
+TEST(TapeStructure, TestMoveRightAcrossChunks) {
+    std::filesystem::path path = "./utests/move_right.txt";
+    std::ofstream(path) << "1  -22 333\n4444 5 66   777 8 99\t1000\n";
+
+    tape_structure::Tape tape(path, 10, 3);
+    while (tape.MoveLeft()) {}
+    tape.Put(-1000);
+
+    std::vector<int32_t> result = {tape.GetCurrentNumber()};
+    while (tape.MoveRight()) {
+        result.push_back(tape.GetCurrentNumber());
+    }
+
+    const std::vector<int32_t> kExpected = {-1000, 99, 8, 777, 66, 5, 4444, 333, -22, 1};
+    EXPECT_EQ(result, kExpected);
+}
+
+TEST(TapeStructure, TestMmapStorage) {
+    std::filesystem::path path_text_in = "./resources/input3.in";
+    std::filesystem::path path_in = "./resources/input3.tape";
+    std::filesystem::path path_out = "./utests/output_mmap.tape";
+    std::filesystem::path path_text_out = "./utests/output_mmap.out";
+
+    tape_structure::Tape::Convert(path_text_in, tape_structure::TapeFormat::kText,
+                                  path_in, tape_structure::TapeFormat::kBinary);
+
+    std::fstream(path_out, std::fstream::out);
+    tape_structure::Tape tape_in(path_in, 26, tape_structure::Tape::CountChunkSize(60, 26),
+                                 tape_structure::TapeFormat::kBinary, tape_structure::TapeStorage::kMmap);
+    tape_structure::Tape tape_out(path_out, tape_structure::Delays(),
+                                  tape_structure::TapeFormat::kBinary, tape_structure::TapeStorage::kMmap);
+
+    tape_structure::TapeSorter sorter(tape_in, tape_out, {.tmp_storage_ = tape_structure::TapeStorage::kMmap,
+                                                          .tmp_dir_ = TmpDir()});
+
+    sorter.Sort();
+
+    tape_structure::Tape::Convert(path_out, tape_structure::TapeFormat::kBinary,
+                                  path_text_out, tape_structure::TapeFormat::kText);
+
+    std::ifstream fin(path_text_out);
+
+    std::string result;
+    std::getline(fin, result);
+
+    const std::string kExpected =
+            "-21435246 -6374869 -675162 -76854 -48130 -9876"
+            " -6254 0 6 865 34578 56342 84613 87645 235646"
+            " 314526 358128 3481364 5343127 5463276 7231462"
+            " 8125637 8745637 56142738 61432576 659298456 ";
+    EXPECT_EQ(result, kExpected);
+}
+
+TEST(TapeStructure, TestMemoryDevice) {
+    tape_structure::Tape tape(std::make_unique<tape_structure::MemoryDevice>(), 10, 3);
+
+    for (int32_t i = 0; i < 10; i++) {
+        tape.Put(i * i);
+        tape.MoveLeft();
+    }
+
+    std::vector<int32_t> result = {tape.GetCurrentNumber()};
+    while (tape.MoveRight()) {
+        result.push_back(tape.GetCurrentNumber());
+    }
+
+    const std::vector<int32_t> kExpected = {81, 64, 49, 36, 25, 16, 9, 4, 1, 0};
+    EXPECT_EQ(result, kExpected);
+}
+
+TEST(TapeStructure, TestMemoryTmpStorage) {
+    std::filesystem::path path_in = "./resources/input3.in";
+    std::filesystem::path path_out = "./utests/output_memory.out";
+
+    tape_structure::Tape tape_in(path_in, 26, tape_structure::Tape::CountChunkSize(60, 26));
+    tape_structure::Tape tape_out(path_out, tape_structure::Delays());
+
+    tape_structure::TapeSorter sorter(tape_in, tape_out, {.tmp_storage_ = tape_structure::TapeStorage::kMemory,
+                                                          .tmp_dir_ = TmpDir()});
+
+    sorter.Sort();
+
+    std::ifstream fin(path_out);
+
+    std::string result;
+    std::getline(fin, result);
+
+    const std::string kExpected =
+            "-21435246 -6374869 -675162 -76854 -48130 -9876"
+            " -6254 0 6 865 34578 56342 84613 87645 235646"
+            " 314526 358128 3481364 5343127 5463276 7231462"
+            " 8125637 8745637 56142738 61432576 659298456 ";
+    EXPECT_EQ(result, kExpected);
+}
+
+TEST(TapeStructure, TestReadAhead) {
+    std::filesystem::path path = "./utests/read_ahead.txt";
+    std::ofstream(path) << "1 2 3 4 5 6 7 8 9 10\n";
+
+    {
+        tape_structure::Tape tape(path, 10, 3);
+        tape.SetReadAhead(true);
+
+        std::vector<int32_t> result = {tape.GetCurrentNumber()};
+        while (tape.MoveLeft()) {
+            int32_t number = tape.GetCurrentNumber();
+            result.push_back(number);
+            if (number % 4 == 0) {
+                tape.Put(-number * 100);
+            }
+        }
+
+        const std::vector<int32_t> kExpected = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+        EXPECT_EQ(result, kExpected);
+    }
+
+    std::ifstream fin(path);
+    std::string result;
+    std::getline(fin, result);
+    EXPECT_EQ(result, "1 2 3 -400 5 6 7 -800 9 10");
+
+    // A binary tape keeps reading ahead after the put numbers are flushed, and reads them back.
+    std::filesystem::path path_binary = "./utests/read_ahead.tape";
+    {
+        tape_structure::Tape tape(path_binary, 10, 3, tape_structure::TapeFormat::kBinary);
+        tape.Append(std::vector<int32_t>{1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+        tape.Flush();
+    }
+    {
+        tape_structure::Tape tape(path_binary, 10, 3, tape_structure::TapeFormat::kBinary);
+        tape.SetReadAhead(true);
+        while (tape.MoveLeft()) {
+            int32_t number = tape.GetCurrentNumber();
+            if (number % 4 == 0) {
+                tape.Put(-number * 100);
+            }
+        }
+
+        std::vector<int32_t> numbers = {tape.GetCurrentNumber()};
+        while (tape.MoveRight()) {
+            numbers.push_back(tape.GetCurrentNumber());
+        }
+        const std::vector<int32_t> kExpected = {10, 9, -800, 7, 6, 5, -400, 3, 2, 1};
+        EXPECT_EQ(numbers, kExpected);
+    }
+
+    std::filesystem::path path_in = "./resources/input3.in";
+    std::filesystem::path path_out = "./utests/output_read_ahead.out";
+
+    tape_structure::Tape tape_in(path_in, 26, tape_structure::Tape::CountChunkSize(60, 26));
+    tape_structure::Tape tape_out(path_out, tape_structure::Delays());
+
+    tape_structure::TapeSorter sorter(tape_in, tape_out, {.read_ahead_ = true, .tmp_dir_ = TmpDir()});
+
+    sorter.Sort();
+
+    std::ifstream sorted(path_out);
+    std::getline(sorted, result);
+
+    const std::string kExpected =
+            "-21435246 -6374869 -675162 -76854 -48130 -9876"
+            " -6254 0 6 865 34578 56342 84613 87645 235646"
+            " 314526 358128 3481364 5343127 5463276 7231462"
+            " 8125637 8745637 56142738 61432576 659298456 ";
+    EXPECT_EQ(result, kExpected);
+}
+
+TEST(TapeStructure, TestAppend) {
+    std::filesystem::path path = "./utests/append.tape";
+    tape_structure::Tape tape(path, 10, 3, tape_structure::TapeFormat::kBinary);
+
+    const std::vector<int32_t> kFirst = {1, 2};
+    const std::vector<int32_t> kSecond = {3, 4, 5, 6, 7};
+    const std::vector<int32_t> kThird = {8, 9, 10};
+    tape.Append(kFirst);
+    tape.Append(kSecond);
+    tape.Flush();
+    tape.Append(kThird);
+
+    EXPECT_THROW(tape.Append(kFirst), std::out_of_range);
+
+    std::vector<int32_t> result = {tape.GetCurrentNumber()};
+    while (tape.MoveLeft()) {
+        result.push_back(tape.GetCurrentNumber());
+    }
+
+    const std::vector<int32_t> kExpected = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    EXPECT_EQ(result, kExpected);
+}
 
+TEST(TapeStructure, TestLoserTree) {
+    std::mt19937 random(8);
+    std::uniform_int_distribution<int32_t> distribution(-5, 5);
+    for (size_t ways: {1, 2, 3, 5, 7, 8, 13}) {
+        // Few distinct numbers, so there are many ties, and every third sequence is empty.
+        std::vector<std::vector<int32_t>> sequences(ways);
+        for (size_t i = 0; i < ways; i++) {
+            if (i % 3 != 2) {
+                sequences[i].resize(1 + random() % 20);
+                std::generate(sequences[i].begin(), sequences[i].end(), [&]() { return distribution(random); });
+                std::sort(sequences[i].begin(), sequences[i].end());
+            }
+        }
+
+        tape_structure::LoserTree tree(ways);
+        std::vector<size_t> positions(ways);
+        for (size_t i = 0; i < ways; i++) {
+            tree.SetNumber(i, sequences[i].empty() ? std::nullopt : std::optional(sequences[i].front()));
+        }
+        tree.Build();
+
+        std::vector<std::pair<int32_t, size_t>> merged;
+        while (!tree.IsEmpty()) {
+            size_t winner = tree.GetWinner();
+            merged.emplace_back(tree.GetWinnerNumber(), winner);
+            size_t next = ++positions[winner];
+            tree.ReplaceWinner(next == sequences[winner].size() ? std::nullopt
+                                                                : std::optional(sequences[winner][next]));
+        }
+
+        // Every number is taken once, and the equal numbers are taken from the smaller index first.
+        std::vector<std::pair<int32_t, size_t>> expected;
+        for (size_t i = 0; i < ways; i++) {
+            for (int32_t number: sequences[i]) {
+                expected.emplace_back(number, i);
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        EXPECT_EQ(merged, expected) << ways << " ways";
+    }
+}
+
+TEST(TapeStructure, TestKWayMerge) {
+    std::filesystem::path path_in = "./utests/k_way.in";
+    std::filesystem::path path_out = "./utests/k_way.out";
+
+    // The memory holds the buffers of the merge of all the runs the split makes.
+    const tape_structure::TapeSize kSize = 80000;
+    const tape_structure::MemorySize kMemory = 262144;
+
+    std::vector<int32_t> numbers = WriteRandomTape(path_in, kSize, 42, -1000, 1000);
+
+    tape_structure::Tape tape_in(path_in, kSize, tape_structure::Tape::CountChunkSize(kMemory, kSize));
+    tape_structure::Tape tape_out(path_out, tape_structure::Delays());
+
+    tape_structure::TapeSorter sorter(tape_in, tape_out, {.tmp_dir_ = TmpDir()});
+
+    // All the runs are merged right into the output tape in one pass:
+    // there are only the split tapes, and no tapes of merge levels.
+    sorter.Sort();
+    const tape_structure::SortStats &stats = sorter.GetStats();
+    EXPECT_GT(stats.runs_, 2);
+    EXPECT_EQ(stats.merge_levels_, 1);
+    EXPECT_EQ(stats.tmp_tapes_.size(), stats.runs_);
+    EXPECT_EQ(stats.max_tmp_tapes_, stats.runs_);
+    for (const std::string &name: stats.tmp_tapes_) {
+        EXPECT_TRUE(name.starts_with("0/")) << name;
+    }
+
+    ExpectSorted(path_out, numbers);
+}
+
+TEST(TapeStructure, TestReplacementSelection) {
+    std::filesystem::path path_in = "./utests/replacement_selection.in";
+    std::filesystem::path path_out = "./utests/replacement_selection.out";
+
+    const tape_structure::TapeSize kSize = 5000;
+    const tape_structure::MemorySize kMemory = 1600;
+
+    std::vector<int32_t> numbers(kSize);
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int32_t> distribution(-1000, 1000);
+    for (size_t i = 0; i < numbers.size(); i++) {
+        numbers[i] = i < kSize / 2 ? distribution(random) : static_cast<int32_t>(i);
+    }
+    WriteTextTape(path_in, numbers);
+
+    for (tape_structure::TapeStorage storage: {tape_structure::TapeStorage::kStream,
+                                               tape_structure::TapeStorage::kMmap,
+                                               tape_structure::TapeStorage::kMemory}) {
+        tape_structure::Tape tape_in(path_in, kSize, tape_structure::Tape::CountChunkSize(kMemory, kSize));
+        tape_structure::Tape tape_out(path_out, tape_structure::Delays());
+
+        tape_structure::TapeSorter sorter(tape_in,
+                                          tape_out,
+                                          {.tmp_storage_ = storage,
+                                           .split_strategy_ = tape_structure::SplitStrategy::kReplacementSelection,
+                                           .tmp_dir_ = TmpDir()});
+
+        sorter.Sort();
+
+        ExpectSorted(path_out, numbers);
+    }
+}
+
+TEST(TapeStructure, TestParallelSplitAndMerge) {
+    std::filesystem::path path_in = "./utests/parallel_split.in";
+    std::filesystem::path path_out = "./utests/parallel_split.out";
+
+    // The memory holds the buffers of 4 merges at once, and the runs are merged in several levels.
+    const tape_structure::TapeSize kSize = 80000;
+    const tape_structure::MemorySize kMemory = 196608;
+
+    std::vector<int32_t> numbers = WriteRandomTape(path_in, kSize, 13, 0, std::numeric_limits<int32_t>::max());
+
+    // The sequential sorting is the reference, the parallel ones with any limit of merges should give the same.
+    std::vector<int32_t> expected;
+    for (tape_structure::SortOptions options: std::vector<tape_structure::SortOptions>{
+                 {.read_ahead_ = true, .workers_ = 1, .memory_ = kMemory},
+                 {.read_ahead_ = true, .workers_ = 4, .memory_ = kMemory},
+                 {.read_ahead_ = true, .workers_ = 4, .merge_io_limit_ = 1, .memory_ = kMemory},
+                 {.read_ahead_ = true, .workers_ = 4, .merge_io_limit_ = 2, .memory_ = kMemory},
+                 {.read_ahead_ = true, .workers_ = 4, .merge_io_limit_ = 3, .memory_ = kMemory},
+                 {.workers_ = 3, .merge_io_limit_ = 2, .memory_ = kMemory}}) {
+        options.tmp_dir_ = TmpDir();
+        tape_structure::Tape tape_in(path_in, kSize, tape_structure::Tape::CountChunkSize(kMemory, kSize));
+        tape_structure::Tape tape_out(path_out, tape_structure::Delays());
+        tape_structure::TapeSorter sorter(tape_in, tape_out, options);
+
+        tape_structure::TapeSize merges = options.merge_io_limit_ != 0
+                                          ? std::min(options.workers_, options.merge_io_limit_)
+                                          : options.workers_;
+        EXPECT_EQ(tape_structure::MemoryPlan(kMemory, kSize, options).GetParallelMerges(), merges);
+
+        // The parallel merges split the memory, so they merge fewer runs at once, and there are merge levels.
+        sorter.Sort();
+        const tape_structure::SortStats &stats = sorter.GetStats();
+        if (merges > 1) {
+            EXPECT_GT(stats.merge_levels_, 1)
+                                << options.workers_ << " workers, merge_io_limit " << options.merge_io_limit_;
+            EXPECT_TRUE(stats.tmp_tapes_.contains("1/0.tape"))
+                                << options.workers_ << " workers, merge_io_limit " << options.merge_io_limit_;
+        }
+
+        std::vector<int32_t> result = ReadTextTape(path_out);
+        if (expected.empty()) {
+            ExpectSorted(path_out, numbers);
+            expected = std::move(result);
+        } else {
+            EXPECT_EQ(result, expected) << options.workers_ << " workers, merge_io_limit " << options.merge_io_limit_;
+        }
+    }
+}
+
+TEST(TapeStructure, TestPolyphaseMerge) {
+    std::filesystem::path path_in = "./utests/polyphase.in";
+    std::filesystem::path path_out = "./utests/polyphase.out";
+
+    const tape_structure::TapeSize kSize = 3000;
+    const tape_structure::MemorySize kMemory = 640;
+
+    std::vector<int32_t> numbers = WriteRandomTape(path_in, kSize, 21, -500, 500);
+
+    for (tape_structure::TapeSize polyphase_tapes: {3, 4, 8}) {
+        tape_structure::Tape tape_in(path_in, kSize, tape_structure::Tape::CountChunkSize(kMemory, kSize));
+        tape_structure::Tape tape_out(path_out, tape_structure::Delays());
+
+        tape_structure::TapeSorter sorter(tape_in, tape_out, {.polyphase_tapes_ = polyphase_tapes,
+                                                              .tmp_dir_ = TmpDir()});
+
+        // Only the polyphase tapes are ever created, however many runs there are.
+        sorter.Sort();
+        const tape_structure::SortStats &stats = sorter.GetStats();
+        EXPECT_GT(stats.runs_, polyphase_tapes);
+        EXPECT_EQ(stats.max_tmp_tapes_, polyphase_tapes);
+        EXPECT_EQ(stats.tmp_tapes_.size(), polyphase_tapes);
+        for (const std::string &name: stats.tmp_tapes_) {
+            EXPECT_LT(std::stoull(name.substr(0, name.find('.'))), polyphase_tapes) << name;
+        }
+
+        ExpectSorted(path_out, numbers);
+    }
+}
+
+TEST(TapeStructure, TestRadixSort) {
+    std::mt19937 random(3);
+    std::uniform_int_distribution<int32_t> distribution(std::numeric_limits<int32_t>::min(),
+                                                        std::numeric_limits<int32_t>::max());
+    std::uniform_int_distribution<int32_t> small_distribution(-3, 3);
+
+    for (size_t size: {0, 1, 100, 5000, 100000}) {
+        std::vector<int32_t> numbers(size);
+        for (size_t i = 0; i < size; i++) {
+            numbers[i] = i % 3 == 0 ? small_distribution(random) : distribution(random);
+        }
+        if (size > 1) {
+            numbers[0] = std::numeric_limits<int32_t>::min();
+            numbers[1] = std::numeric_limits<int32_t>::max();
+        }
+
+        std::vector<int32_t> expected = numbers;
+        std::sort(expected.begin(), expected.end());
+
+        std::vector<int32_t> result = numbers;
+        tape_structure::RadixSort(result);
+        EXPECT_EQ(result, expected);
+
+        result = numbers;
+        tape_structure::SortRun(result);
+        EXPECT_EQ(result, expected);
+    }
+}
+
+TEST(TapeStructure, TestMergeKernel) {
+    std::mt19937 random(5);
+    std::uniform_int_distribution<int32_t> distribution(std::numeric_limits<int32_t>::min(),
+                                                        std::numeric_limits<int32_t>::max());
+    std::uniform_int_distribution<int32_t> small_distribution(-3, 3);
+
+    for (auto [first_size, second_size]: {std::pair<size_t, size_t>{0, 0}, {0, 5}, {7, 0}, {3, 9},
+                                          {8, 8}, {17, 40}, {1000, 1003}, {4096, 77}}) {
+        std::vector<int32_t> first(first_size);
+        std::vector<int32_t> second(second_size);
+        for (size_t i = 0; i < first_size; i++) {
+            first[i] = i % 2 == 0 ? small_distribution(random) : distribution(random);
+        }
+        for (size_t i = 0; i < second_size; i++) {
+            second[i] = i % 2 == 0 ? small_distribution(random) : distribution(random);
+        }
+        std::sort(first.begin(), first.end());
+        std::sort(second.begin(), second.end());
+
+        std::vector<int32_t> expected(first_size + second_size);
+        std::merge(first.begin(), first.end(), second.begin(), second.end(), expected.begin());
+
+        std::vector<int32_t> result(first_size + second_size);
+        tape_structure::MergeSorted(first, second, result.data());
+        EXPECT_EQ(result, expected);
+
+        tape_structure::MergeSortedScalar(first, second, result.data());
+        EXPECT_EQ(result, expected);
+    }
+}
+
+TEST(TapeStructure, TestMemoryPlan) {
+    using tape_structure::SplitStrategy;
+
+    using tape_structure::TapeFormat;
+
+    // The memory of every phase counts the devices of the open tapes, so it is a hard limit from the least memory up.
+    for (tape_structure::MemorySize extra: {0, 1600, 40960, 1 << 20}) {
+        for (tape_structure::TapeSize size: {100, 20000, 1000000}) {
+            for (bool read_ahead: {false, true}) {
+                std::vector<tape_structure::SortOptions> all_options = {
+                        {.read_ahead_ = read_ahead},
+                        {.read_ahead_ = read_ahead, .workers_ = 4},
+                        {.read_ahead_ = read_ahead, .split_strategy_ = SplitStrategy::kReplacementSelection},
+                        {.read_ahead_ = read_ahead, .split_strategy_ = SplitStrategy::kNaturalRuns},
+                        {.tmp_format_ = TapeFormat::kCompressed, .read_ahead_ = read_ahead, .workers_ = 2},
+                        {.read_ahead_ = read_ahead, .polyphase_tapes_ = 5}};
+                for (const tape_structure::SortOptions &options: all_options) {
+                    uint64_t least = tape_structure::MemoryPlan::CountLeastMemory(size, options);
+                    tape_structure::MemoryPlan plan(least + extra, size, options);
+                    EXPECT_LE(plan.CountPeakMemory(size), least + extra);
+                    EXPECT_LE(plan.CountPeakMemory((size - 1) / plan.GetSplitChunkSize() + 1), least + extra);
+                    EXPECT_THROW(tape_structure::MemoryPlan(least - 1, size, options), std::invalid_argument);
+                }
+            }
+        }
+    }
+    EXPECT_THROW(tape_structure::MemoryPlan(16, 100, {}), std::invalid_argument);
+
+    std::filesystem::path path_in = "./utests/memory_plan.in";
+    std::filesystem::path path_out = "./utests/memory_plan.out";
+    const tape_structure::TapeSize kSize = 20000;
+    std::vector<int32_t> numbers = WriteRandomTape(path_in, kSize, 17, 0, std::numeric_limits<int32_t>::max());
+
+    tape_structure::Tape tape_in(path_in, kSize, tape_structure::Tape::CountChunkSize(1600, kSize));
+    tape_structure::Tape tape_out(path_out, tape_structure::Delays());
+    tape_structure::TapeSorter sorter(tape_in, tape_out, {.read_ahead_ = true, .memory_ = 40960, .tmp_dir_ = TmpDir()});
+    sorter.Sort();
+
+    ExpectSorted(path_out, numbers);
+}
+
+TEST(TapeStructure, TestNaturalRuns) {
+    std::filesystem::path path_in = "./utests/natural_runs.in";
+    std::filesystem::path path_out = "./utests/natural_runs.out";
+
+    const tape_structure::TapeSize kSize = 20000;
+    std::mt19937 random(11);
+    std::uniform_int_distribution<int32_t> distribution(-100000, 100000);
+
+    std::vector<int32_t> sorted(kSize);
+    for (int32_t &number: sorted) {
+        number = distribution(random);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<int32_t> reversed(sorted.rbegin(), sorted.rend());
+    std::vector<int32_t> logs;
+    for (size_t i = 0; i < 3; i++) {
+        logs.insert(logs.end(), sorted.begin() + i, sorted.begin() + i + kSize / 3);
+    }
+    logs.insert(logs.end(), sorted.begin(), sorted.begin() + (kSize - logs.size()));
+    std::vector<int32_t> mixed = sorted;
+    std::reverse(mixed.begin() + kSize / 4, mixed.begin() + kSize / 2);
+    std::shuffle(mixed.begin() + 3 * kSize / 4, mixed.end(), random);
+    std::vector<int32_t> equal(kSize, 7);
+
+    for (const std::vector<int32_t> &numbers: {sorted, reversed, logs, mixed, equal}) {
+        WriteTextTape(path_in, numbers);
+        for (tape_structure::TapeStorage storage: {tape_structure::TapeStorage::kStream,
+                                                   tape_structure::TapeStorage::kMmap,
+                                                   tape_structure::TapeStorage::kMemory}) {
+            tape_structure::Tape tape_in(path_in, kSize, tape_structure::Tape::CountChunkSize(1600, kSize));
+            tape_structure::Tape tape_out(path_out, tape_structure::Delays());
+
+            tape_structure::TapeSorter sorter(tape_in,
+                                              tape_out,
+                                              {.tmp_storage_ = storage,
+                                               .split_strategy_ = tape_structure::SplitStrategy::kNaturalRuns,
+                                               .memory_ = 49152,
+                                               .tmp_dir_ = TmpDir()});
+
+            sorter.Sort();
+
+            ExpectSorted(path_out, numbers);
+        }
+    }
+
+    // A descending tape whose size is a multiple of the chunks of the split (2048 numbers with this memory)
+    // is one reversed run, which is rewritten right to the output tape.
+    const tape_structure::TapeSize kMultipleSize = 10 * 2048;
+    std::vector<int32_t> descending(kMultipleSize);
+    std::iota(descending.rbegin(), descending.rend(), 1);
+    WriteTextTape(path_in, descending);
+    tape_structure::Tape tape_in(path_in, kMultipleSize, tape_structure::Tape::CountChunkSize(1600, kMultipleSize));
+    tape_structure::Tape tape_out(path_out, tape_structure::Delays());
+    tape_structure::TapeSorter sorter(tape_in,
+                                      tape_out,
+                                      {.split_strategy_ = tape_structure::SplitStrategy::kNaturalRuns,
+                                       .memory_ = 49152,
+                                       .tmp_dir_ = TmpDir()});
     sorter.Sort();
 
+    ExpectSorted(path_out, descending);
+}
+
+TEST(TapeStructure, TestVirtualDelays) {
+    if (!tape_structure::kEmulateDelays) {
+        GTEST_SKIP() << "Delays are not emulated in this build";
+    }
+
+    tape_structure::Delays delays(1ms, 2ms, 3ms, tape_structure::DelayMode::kVirtual);
+    tape_structure::Delays first = delays.ForTape();
+    tape_structure::Delays second = delays.ForTape();
+    first.Wait(first.delay_for_put_, 5);
+    second.Wait(second.delay_for_shift_);
+    EXPECT_EQ(first.GetElapsed(), 10ms);
+    EXPECT_EQ(second.GetElapsed(), 3ms);
+    EXPECT_EQ(delays.GetTotalElapsed(), 13ms);
+
+    std::filesystem::path path_in = "./resources/input3.in";
+    std::filesystem::path path_out = "./utests/output_virtual.out";
+
+    // An hour of every operation is simulated without sleeping.
+    tape_structure::Delays hours(1h, 1h, 1h, tape_structure::DelayMode::kVirtual);
+    tape_structure::Tape tape_in(path_in, 26, tape_structure::Tape::CountChunkSize(60, 26), hours);
+    tape_structure::Tape tape_out(path_out, hours);
+
+    tape_structure::TapeSorter sorter(tape_in, tape_out, {.tmp_dir_ = TmpDir()});
+
+    auto start = std::chrono::steady_clock::now();
+    sorter.Sort();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1min);
+    EXPECT_GE(sorter.GetSimulatedTime(), std::chrono::milliseconds(3 * 26 * 1h));
+    EXPECT_EQ(sorter.GetSimulatedTime(), hours.GetTotalElapsed());
+
     std::ifstream fin(path_out);
 
     std::string result;
@@ -129,4 +848,374 @@ TEST(TapeStructure, TestResultFile3) {
             " 314526 358128 3481364 5343127 5463276 7231462"
             " 8125637 8745637 56142738 61432576 659298456 ";
     EXPECT_EQ(result, kExpected);
-}
\ No newline at end of file
+}
+
+TEST(TapeStructure, TestAlternateDirections) {
+    if (!tape_structure::kEmulateDelays) {
+        GTEST_SKIP() << "Delays are not emulated in this build";
+    }
+
+    std::filesystem::path path_in = "./utests/alternate_directions.in";
+    std::filesystem::path path_out = "./utests/alternate_directions.out";
+
+    const tape_structure::TapeSize kSize = 20000;
+    std::vector<int32_t> numbers = WriteRandomTape(path_in,
+                                                   kSize,
+                                                   23,
+                                                   std::numeric_limits<int32_t>::min(),
+                                                   std::numeric_limits<int32_t>::max());
+
+    for (tape_structure::MemorySize memory: {16384, 24576, 98304}) {
+        for (tape_structure::SplitStrategy split: {tape_structure::SplitStrategy::kSortChunks,
+                                                   tape_structure::SplitStrategy::kReplacementSelection}) {
+            for (bool read_ahead: {false, true}) {
+                std::vector<uint64_t> shifts;
+                for (bool alternate: {false, true}) {
+                    tape_structure::Delays delays(0ms, 0ms, 1ms, tape_structure::DelayMode::kVirtual);
+                    tape_structure::Tape tape_in(path_in, kSize, tape_structure::Tape::CountChunkSize(1600, kSize),
+                                                 delays);
+                    tape_structure::Tape tape_out(path_out, delays);
+
+                    tape_structure::TapeSorter sorter(tape_in,
+                                                      tape_out,
+                                                      {.read_ahead_ = read_ahead,
+                                                       .split_strategy_ = split,
+                                                       .memory_ = memory,
+                                                       .alternate_directions_ = alternate,
+                                                       .tmp_dir_ = TmpDir()});
+                    sorter.Sort();
+                    shifts.push_back(sorter.GetShiftCount());
+
+                    ExpectSorted(path_out, numbers);
+                }
+                // The runs of replacement selection are ascending, so they are rewound if there is one level.
+                if (split == tape_structure::SplitStrategy::kSortChunks) {
+                    EXPECT_LT(shifts[1], shifts[0]);
+                } else {
+                    EXPECT_LE(shifts[1], shifts[0]);
+                }
+            }
+        }
+    }
+}
+
+TEST(TapeStructure, TestMoveAndCopyFile) {
+    std::filesystem::path path_from = "./utests/move_from.tape";
+    std::filesystem::path path_copy = "./utests/move_copy.tape";
+    std::filesystem::path path_to = "./utests/move_to.tape";
+    std::filesystem::path path_text = "./utests/move_to.out";
+    const std::vector<int32_t> kNumbers = {7, -3, 12, 0, 45, -100, 8};
+
+    auto read_all = [](tape_structure::Tape &tape) {
+        std::vector<int32_t> numbers = {tape.GetCurrentNumber()};
+        while (tape.MoveLeft()) {
+            numbers.push_back(tape.GetCurrentNumber());
+        }
+        return numbers;
+    };
+
+    tape_structure::Tape from(path_from, kNumbers.size(), 3, tape_structure::TapeFormat::kBinary);
+    // The numbers are not flushed, the copy flushes them first.
+    from.Append(kNumbers);
+
+    tape_structure::Tape copy(from, path_copy);
+    EXPECT_EQ(read_all(copy), kNumbers);
+    EXPECT_EQ(std::filesystem::file_size(path_copy), std::filesystem::file_size(path_from));
+
+    // The file of the same format is renamed.
+    tape_structure::Tape to(path_to, tape_structure::Delays(), tape_structure::TapeFormat::kBinary);
+    to = std::move(from);
+    EXPECT_FALSE(std::filesystem::exists(path_from));
+    EXPECT_EQ(read_all(to), kNumbers);
+
+    // The file of another format is rewritten.
+    tape_structure::Tape text(path_text, tape_structure::Delays());
+    text = std::move(copy);
+    EXPECT_TRUE(std::filesystem::exists(path_copy));
+
+    std::ifstream fin(path_text);
+    std::string result;
+    std::getline(fin, result);
+    EXPECT_EQ(result, "7 -3 12 0 45 -100 8 ");
+
+    // A tape over another device (a descending run of the split) is rewritten with its own size and chunks,
+    // which are opened before the ones of the empty tape are taken.
+    std::filesystem::path path_pieces = "./utests/move_pieces.tape";
+    std::filesystem::path path_reversed = "./utests/move_reversed.out";
+    tape_structure::Tape pieces(path_pieces, 6, 3, tape_structure::TapeFormat::kBinary);
+    pieces.Append(std::vector<int32_t>{4, 5, 6, 1, 2, 3});
+    pieces.Flush();
+    tape_structure::Tape reversed(
+            std::make_unique<tape_structure::ReversedDevice>(
+                    tape_structure::MakeTapeDevice(path_pieces, tape_structure::TapeFormat::kBinary,
+                                                   tape_structure::TapeStorage::kStream),
+                    3),
+            6, 3);
+    tape_structure::Tape from_reversed(path_reversed, tape_structure::Delays());
+    from_reversed = std::move(reversed);
+    EXPECT_EQ(read_all(from_reversed), std::vector<int32_t>({1, 2, 3, 4, 5, 6}));
+}
+
+TEST(TapeStructure, TestTextCodec) {
+    std::mt19937 generator(21);
+    std::uniform_int_distribution<int32_t> distribution(std::numeric_limits<int32_t>::min(),
+                                                        std::numeric_limits<int32_t>::max());
+    std::vector<int32_t> numbers = {std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max(), 0};
+    for (size_t i = 0; i < 3 * tape_structure::text_format::TextReader::kBlockSize / 8; i++) {
+        numbers.push_back(distribution(generator));
+    }
+
+    std::ostringstream expected;
+    for (int32_t number: numbers) {
+        expected << number << ' ';
+    }
+    std::string text;
+    tape_structure::text_format::AppendNumbers(text, numbers.data(), numbers.size());
+    EXPECT_EQ(text, expected.str());
+
+    // Numbers split between the blocks, other whitespace characters and signs are read like by the stream.
+    std::string spaced = "\n\t+17  -0 0042\r\n" + text + "\n 5";
+    std::istringstream expected_in(spaced);
+    std::istringstream in(spaced);
+    tape_structure::text_format::TextReader reader(in);
+    std::vector<int32_t> read(numbers.size() + 5);
+    EXPECT_EQ(reader.ReadNumbers(read.data(), read.size()), read.size() - 1);
+    for (size_t i = 0; i + 1 < read.size(); i++) {
+        int32_t number;
+        expected_in >> number;
+        EXPECT_EQ(read[i], number);
+    }
+    EXPECT_EQ(read.back(), 0);
+    EXPECT_EQ(reader.Tell(), static_cast<std::streamoff>(spaced.size()));
+
+    reader.Seek(0);
+    reader.SkipSpaces();
+    EXPECT_EQ(reader.Tell(), 2);
+}
+
+TEST(TapeStructure, TestCompressedTmpTapes) {
+    using tape_structure::SplitStrategy;
+
+    std::filesystem::path path_in = "./utests/compressed.in";
+    std::filesystem::path path_out = "./utests/compressed.out";
+    std::filesystem::path path_binary = "./utests/compressed_binary.tape";
+    std::filesystem::path path_compressed = "./utests/compressed.tape";
+    std::filesystem::path path_text = "./utests/compressed_text.out";
+    std::filesystem::path path_sorted = "./utests/compressed_sorted.tape";
+
+    const tape_structure::TapeSize kSize = 20000;
+    std::vector<int32_t> numbers = WriteRandomTape(path_in, kSize, 22, -1000000, 1000000);
+    numbers[1] = std::numeric_limits<int32_t>::min();
+    numbers[2] = std::numeric_limits<int32_t>::max();
+    WriteTextTape(path_in, numbers);
+
+    std::vector<tape_structure::SortOptions> all_options = {
+            {.tmp_format_ = tape_structure::TapeFormat::kCompressed, .memory_ = 40960},
+            {.tmp_format_ = tape_structure::TapeFormat::kCompressed, .read_ahead_ = true, .memory_ = 1 << 20},
+            {.tmp_format_ = tape_structure::TapeFormat::kCompressed,
+             .split_strategy_ = SplitStrategy::kReplacementSelection,
+             .memory_ = 40960},
+            {.tmp_format_ = tape_structure::TapeFormat::kCompressed,
+             .split_strategy_ = SplitStrategy::kNaturalRuns,
+             .memory_ = 49152},
+            {.tmp_format_ = tape_structure::TapeFormat::kCompressed, .polyphase_tapes_ = 4, .memory_ = 1 << 17},
+            {.tmp_format_ = tape_structure::TapeFormat::kCompressed,
+             .memory_ = 40960,
+             .alternate_directions_ = true}};
+    for (tape_structure::SortOptions &options: all_options) {
+        options.tmp_dir_ = TmpDir();
+        tape_structure::Tape tape_in(path_in, kSize, tape_structure::Tape::CountChunkSize(1600, kSize));
+        tape_structure::Tape tape_out(path_out, tape_structure::Delays());
+        tape_structure::TapeSorter sorter(tape_in, tape_out, options);
+        sorter.Sort();
+
+        ExpectSorted(path_out, numbers);
+    }
+
+    // Chunks which are not whole blocks are spliced into the blocks.
+    tape_structure::Tape tape(path_compressed, 2500, 700, tape_structure::TapeFormat::kCompressed);
+    tape.Append(std::span(numbers).first(2500));
+    tape.Flush();
+    tape.Truncate(2300);
+    tape_structure::Tape::Convert(path_compressed, tape_structure::TapeFormat::kCompressed,
+                                  path_text, tape_structure::TapeFormat::kText);
+    EXPECT_EQ(ReadTextTape(path_text), std::vector<int32_t>(numbers.begin(), numbers.begin() + 2300));
+
+    // A sorted tape takes a fraction of the binary one.
+    tape_structure::Tape::Convert(path_out, tape_structure::TapeFormat::kText,
+                                  path_binary, tape_structure::TapeFormat::kBinary);
+    tape_structure::Tape::Convert(path_out, tape_structure::TapeFormat::kText,
+                                  path_sorted, tape_structure::TapeFormat::kCompressed);
+    EXPECT_LT(2 * std::filesystem::file_size(path_sorted), std::filesystem::file_size(path_binary));
+}
+
+template <typename T>
+void CheckElementType(std::vector<T> numbers) {
+    std::vector<T> expected = numbers;
+    std::sort(expected.begin(), expected.end());
+    std::vector<T> result = numbers;
+    std::vector<T> scratch;
+    tape_structure::RadixSort(std::span(result), scratch);
+    EXPECT_EQ(result, expected);
+
+    std::string text;
+    tape_structure::text_format::AppendNumbers(text, numbers.data(), numbers.size());
+    std::istringstream in(text);
+    tape_structure::text_format::TextReader reader(in);
+    result.assign(numbers.size(), T{});
+    EXPECT_EQ(reader.ReadNumbers(result.data(), result.size()), numbers.size());
+    EXPECT_EQ(result, numbers);
+
+    std::string block;
+    tape_structure::compressed_format::AppendBlock(block, numbers.data(), numbers.size());
+    std::string_view encoded = std::string_view(block).substr(tape_structure::compressed_format::kBlockHeaderSize);
+    result.assign(numbers.size(), T{});
+    tape_structure::compressed_format::DecodeBlock(encoded, result.data(), result.size());
+    EXPECT_EQ(result, numbers);
+}
+
+TEST(TapeStructure, TestElementTypes) {
+    std::mt19937_64 random(23);
+    const size_t kSize = tape_structure::compressed_format::kBlockLength;
+
+    std::vector<int64_t> int64_numbers(kSize);
+    std::vector<uint64_t> uint64_numbers(kSize);
+    std::vector<uint32_t> uint32_numbers(kSize);
+    std::vector<double> double_numbers(kSize);
+    std::vector<float> float_numbers(kSize);
+    std::uniform_real_distribution<double> real_distribution(-1e9, 1e9);
+    for (size_t i = 0; i < kSize; i++) {
+        uint64_t bits = random();
+        int64_numbers[i] = static_cast<int64_t>(bits);
+        uint64_numbers[i] = bits;
+        uint32_numbers[i] = static_cast<uint32_t>(bits);
+        double_numbers[i] = i % 5 == 0 ? static_cast<double>(int64_numbers[i]) : real_distribution(random);
+        float_numbers[i] = static_cast<float>(real_distribution(random));
+    }
+    int64_numbers[0] = std::numeric_limits<int64_t>::min();
+    int64_numbers[1] = std::numeric_limits<int64_t>::max();
+    double_numbers[0] = std::numeric_limits<double>::lowest();
+    double_numbers[1] = std::numeric_limits<double>::denorm_min();
+    double_numbers[2] = -std::numeric_limits<double>::denorm_min();
+
+    CheckElementType(int64_numbers);
+    CheckElementType(uint64_numbers);
+    CheckElementType(uint32_numbers);
+    CheckElementType(double_numbers);
+    CheckElementType(float_numbers);
+}
+
+TEST(TapeStructure, TestLargeSizes) {
+    const tape_structure::TapeSize kSize = (tape_structure::TapeSize{1} << 32) + 5000;
+    const tape_structure::MemorySize kMemory = tape_structure::MemorySize{256} << 30;
+
+    // The chunks and the memory of the plan are not limited by 32 bits.
+    tape_structure::MemoryPlan plan(kMemory, 16 * kSize, {});
+    EXPECT_GT(plan.GetSplitChunkSize(), std::numeric_limits<uint32_t>::max());
+    EXPECT_LE(plan.CountPeakMemory(16), kMemory);
+    EXPECT_GT(tape_structure::Tape::CountChunkSize(kMemory, kSize), std::numeric_limits<uint32_t>::max());
+
+    std::filesystem::path path = "./utests/large_sizes.tape";
+    tape_structure::Tape tape(path, kSize, 1, tape_structure::TapeFormat::kBinary);
+    EXPECT_EQ(tape.GetCountOfChunks(), kSize);
+
+    // The last chunk of the tape lies beyond 16 GiB of the file, the file is sparse.
+    const tape_structure::ChunkSize kChunkSize = 1024;
+    const tape_structure::ChunksCount kLastChunk = (kSize - 1) / kChunkSize;
+    std::vector<int32_t> numbers(kSize - kLastChunk * kChunkSize);
+    std::iota(numbers.begin(), numbers.end(), -7);
+    {
+        std::unique_ptr<tape_structure::TapeDevice> device = tape_structure::MakeTapeDevice(
+                path, tape_structure::TapeFormat::kBinary, tape_structure::TapeStorage::kStream);
+        device->Open(kSize, kChunkSize);
+        device->WriteChunk(kLastChunk, numbers);
+
+        std::vector<int32_t> result(numbers.size());
+        device->ReadChunk(kLastChunk, result);
+        EXPECT_EQ(result, numbers);
+    }
+    EXPECT_EQ(std::filesystem::file_size(path), tape_structure::binary_format::OffsetOf(kSize, sizeof(int32_t)));
+    std::filesystem::remove(path);
+}
+
+TEST(TapeStructure, TestChunkPool) {
+    auto pool = std::make_shared<tape_structure::ChunkPool>(true);
+    const int32_t *data;
+    {
+        tape_structure::ChunkBuffer buffer(pool);
+        buffer.Append(std::vector<int32_t>{1, 2, 3});
+        buffer.Resize(5000);
+        EXPECT_EQ(std::vector<int32_t>(buffer.GetData(), buffer.GetData() + 3), std::vector<int32_t>({1, 2, 3}));
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer.GetData()) % tape_structure::ChunkPool::kAlignment, 0);
+        data = buffer.GetData();
+    }
+    // The memory of the three numbers was given back when the buffer grew.
+    EXPECT_EQ(pool->CountFreeBuffers(), 2);
+
+    // The released memory is taken by the next buffer which fits in it.
+    tape_structure::ChunkBuffer small(pool);
+    small.Resize(1000);
+    EXPECT_EQ(small.GetData(), data);
+    EXPECT_EQ(pool->CountFreeBuffers(), 1);
+
+    tape_structure::ChunkBuffer huge(pool);
+    huge.Resize(tape_structure::ChunkPool::kHugePageSize);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(huge.GetData()) % tape_structure::ChunkPool::kHugePageSize, 0);
+    huge.Release();
+    small.Release();
+    pool->Trim();
+    EXPECT_EQ(pool->CountFreeBuffers(), 0);
+
+    // Each cycle takes a buffer bigger than all the released ones, it replaces only the biggest of them.
+    // So the small buffers are allocated in the first cycle (one more, since the first big buffer replaces
+    // a small one), and the next cycles allocate only the big buffer.
+    auto mixed_pool = std::make_shared<tape_structure::ChunkPool>();
+    const size_t kCycles = 10;
+    for (size_t i = 1; i <= kCycles; i++) {
+        std::vector<tape_structure::ChunkBuffer> smalls;
+        for (size_t j = 0; j < 3; j++) {
+            smalls.emplace_back(mixed_pool).Resize(1000);
+        }
+        smalls.clear();
+
+        tape_structure::ChunkBuffer big(mixed_pool);
+        big.Resize(2000 * i);
+        for (size_t j = 0; j < 3; j++) {
+            smalls.emplace_back(mixed_pool).Resize(1000);
+        }
+    }
+    EXPECT_EQ(mixed_pool->CountAllocations(), 4 + kCycles);
+    EXPECT_EQ(mixed_pool->CountFreeBuffers(), 4);
+
+    // The released buffer over the limit is freed, the one within it is kept.
+    const size_t kBlockMemory = tape_structure::ChunkPool::CountBlockMemory(1000, false);
+    auto limited_pool = std::make_shared<tape_structure::ChunkPool>();
+    limited_pool->SetLimit(kBlockMemory);
+    {
+        tape_structure::ChunkBuffer first(limited_pool);
+        first.Resize(1000);
+        tape_structure::ChunkBuffer second(limited_pool);
+        second.Resize(1000);
+        EXPECT_EQ(limited_pool->CountMemory(), 2 * kBlockMemory);
+    }
+    EXPECT_EQ(limited_pool->CountFreeBuffers(), 1);
+    EXPECT_EQ(limited_pool->CountMemory(), kBlockMemory);
+
+    std::filesystem::path path_in = "./utests/chunk_pool.in";
+    std::filesystem::path path_out = "./utests/chunk_pool.out";
+    const tape_structure::TapeSize kSize = 20000;
+    std::vector<int32_t> numbers = WriteRandomTape(path_in, kSize, 25, 0, std::numeric_limits<int32_t>::max());
+
+    for (tape_structure::SortOptions options: std::vector<tape_structure::SortOptions>{
+                 {.read_ahead_ = true, .memory_ = 40960, .alternate_directions_ = true, .huge_pages_ = true},
+                 {.workers_ = 4, .memory_ = 40960},
+                 {.polyphase_tapes_ = 4, .memory_ = 40960}}) {
+        options.tmp_dir_ = TmpDir();
+        tape_structure::Tape tape_in(path_in, kSize, tape_structure::Tape::CountChunkSize(1600, kSize));
+        tape_structure::Tape tape_out(path_out, tape_structure::Delays());
+        tape_structure::TapeSorter sorter(tape_in, tape_out, options);
+        sorter.Sort();
+
+        ExpectSorted(path_out, numbers);
+    }
+}